@@ -103,37 +103,55 @@ xfdesktop_get_file_mimetype(const gchar *file)
     return mime_type;
 }
 
+/* Returns TRUE if gdk-pixbuf can load files of type mime_type.  The mime
+ * types of all the pixbuf formats are collected in a hash table the first
+ * time this is called, so checking a file is a single lookup. */
 gboolean
-xfdesktop_image_file_is_valid(const gchar *filename)
+xfdesktop_image_mime_type_is_valid(const gchar *mime_type)
 {
-    static GSList *pixbuf_formats = NULL;
-    GSList *l;
-    gboolean image_valid = FALSE;
-    gchar *file_mimetype;
+    static GHashTable *pixbuf_mime_types = NULL;
 
-    g_return_val_if_fail(filename, FALSE);
+    if(mime_type == NULL)
+        return FALSE;
 
-    if(pixbuf_formats == NULL) {
-        pixbuf_formats = gdk_pixbuf_get_formats();
-    }
+    if(pixbuf_mime_types == NULL) {
+        GSList *pixbuf_formats, *l;
 
-    file_mimetype = xfdesktop_get_file_mimetype(filename);
+        pixbuf_mime_types = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                  g_free, NULL);
 
-    if(file_mimetype == NULL)
-        return FALSE;
+        /* Every pixbuf format has a list of mime types we can compare
+         * against */
+        pixbuf_formats = gdk_pixbuf_get_formats();
+        for(l = pixbuf_formats; l != NULL; l = g_slist_next(l)) {
+            gint i;
+            gchar **mimetypes = gdk_pixbuf_format_get_mime_types(l->data);
 
-    /* Every pixbuf format has a list of mime types we can compare against */
-    for(l = pixbuf_formats; l != NULL && image_valid == FALSE; l = g_slist_next(l)) {
-        gint i;
-        gchar ** mimetypes = gdk_pixbuf_format_get_mime_types(l->data);
+            /* the table takes over the strings */
+            for(i = 0; mimetypes[i] != NULL; i++)
+                g_hash_table_insert(pixbuf_mime_types, mimetypes[i],
+                                    GINT_TO_POINTER(TRUE));
 
-        for(i = 0; mimetypes[i] != NULL && image_valid == FALSE; i++) {
-            if(g_strcmp0(file_mimetype, mimetypes[i]) == 0)
-                image_valid = TRUE;
+            g_free(mimetypes);
         }
-         g_strfreev(mimetypes);
+        g_slist_free(pixbuf_formats);
     }
 
+    return g_hash_table_lookup(pixbuf_mime_types, mime_type) != NULL;
+}
+
+gboolean
+xfdesktop_image_file_is_valid(const gchar *filename)
+{
+    gboolean image_valid;
+    gchar *file_mimetype;
+
+    g_return_val_if_fail(filename, FALSE);
+
+    file_mimetype = xfdesktop_get_file_mimetype(filename);
+
+    image_valid = xfdesktop_image_mime_type_is_valid(file_mimetype);
+
     g_free(file_mimetype);
 
     return image_valid;
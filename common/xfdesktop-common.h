@@ -54,6 +54,8 @@
 
 #define SINGLE_WORKSPACE_MODE     "/backdrop/single-workspace-mode"
 #define SINGLE_WORKSPACE_NUMBER   "/backdrop/single-workspace-number"
+#define BACKDROP_CACHE_SIZE       "/backdrop/cache-size"
+#define BACKDROP_FADE_DURATION    "/backdrop/fade-duration"
 
 #define DESKTOP_ICONS_SHOW_THUMBNAILS        "/desktop-icons/show-thumbnails"
 #define DESKTOP_ICONS_SHOW_HIDDEN_FILES      "/desktop-icons/show-hidden-files"
@@ -92,6 +94,8 @@ G_BEGIN_DECLS
 
 gint xfdesktop_compare_paths(GFile *a, GFile *b);
 
+gboolean xfdesktop_image_mime_type_is_valid(const gchar *mime_type);
+
 gboolean xfdesktop_image_file_is_valid(const gchar *filename);
 
 gchar *xfdesktop_get_file_mimetype(const gchar *file);
@@ -30,6 +30,24 @@
 #include <math.h>
 #include <string.h>
 
+/* Dividing by the filter width used to be the slowest part of every pass,
+ * so we multiply by a fixed point reciprocal instead.  The sums a pass
+ * produces are below 256 * d, and with 22 fractional bits the result is
+ * exactly (sum + d / 2) / d as long as d < 128, without the product
+ * overflowing 32 bits.  Wider filters fall back to dividing.
+ */
+#define RECIPROCAL_SHIFT 22
+#define RECIPROCAL_MAX_D 128
+
+static inline guint32
+reciprocal (int d)
+{
+  if (d >= RECIPROCAL_MAX_D)
+    return 0;
+
+  return ((1u << RECIPROCAL_SHIFT) + d - 1) / d;
+}
+
 /* This applies a single box blur pass to a horizontal range of pixels;
  * since the box blur has the same weight for all pixels, we can
  * implement an efficient sliding window algorithm where we add
@@ -47,6 +65,7 @@ blur_xspan (guchar *row,
             int     d,
             int     shift)
 {
+  guint32 mul = reciprocal (d);
   int offset;
   int sum = 0;
   int i;
@@ -59,11 +78,7 @@ blur_xspan (guchar *row,
   /* All the conditionals in here look slow, but the branches will
    * be well predicted and there are enough different possibilities
    * that trying to write this as a series of unconditional loops
-   * is hard and not an obvious win. The main slow down here seems
-   * to be the integer division per pixel; one possible optimization
-   * would be to accumulate into two 16-bit integer buffers and
-   * only divide down after all three passes. (SSE parallel implementation
-   * of the divide step is possible.)
+   * is hard and not an obvious win.
    */
   for (i = -d + offset; i < row_width + offset; i++)
     {
@@ -75,7 +90,10 @@ blur_xspan (guchar *row,
           if (i >= d)
             sum -= row[i - d];
 
-          tmp_buffer[i - offset] = (sum + d / 2) / d;
+          if (mul)
+            tmp_buffer[i - offset] = ((guint32) (sum + d / 2) * mul) >> RECIPROCAL_SHIFT;
+          else
+            tmp_buffer[i - offset] = (sum + d / 2) / d;
         }
     }
 
@@ -116,33 +134,99 @@ blur_rows (guchar *dst_buffer,
     }
 }
 
-/* Swaps width and height.
+/* The vertical counterpart of blur_xspan(), reading @src and writing
+ * @dst.  Instead of sliding one window down each column, it keeps a
+ * window sum per column in @sums and moves all of them a whole row at
+ * a time.  That way every inner loop walks contiguous memory with no
+ * dependencies between iterations, which the compiler can turn into
+ * SIMD code, and the buffer doesn't need to be transposed.
  */
 static void
-flip_buffer (guchar *dst_buffer,
-             guchar *src_buffer,
-             int     width,
-             int     height)
+blur_yspan (guchar       *dst,
+            const guchar *src,
+            guint32      *sums,
+            int           width,
+            int           height,
+            int           d,
+            int           shift)
 {
-  /* Working in blocks increases cache efficiency, compared to reading
-   * or writing an entire column at once
-   */
-#define BLOCK_SIZE 16
-
-  int i0, j0;
-
-  for (i0 = 0; i0 < width; i0 += BLOCK_SIZE)
-    for (j0 = 0; j0 < height; j0 += BLOCK_SIZE)
-      {
-        int max_j = MIN(j0 + BLOCK_SIZE, height);
-        int max_i = MIN(i0 + BLOCK_SIZE, width);
-        int i, j;
-
-        for (i = i0; i < max_i; i++)
-          for (j = j0; j < max_j; j++)
-            dst_buffer[i * height + j] = src_buffer[j * width + i];
-      }
-#undef BLOCK_SIZE
+  guint32 mul = reciprocal (d);
+  guint32 half = d / 2;
+  int offset;
+  int i, x;
+
+  if (d % 2 == 1)
+    offset = d / 2;
+  else
+    offset = (d - shift) / 2;
+
+  memset (sums, 0, width * sizeof (guint32));
+
+  for (i = -d + offset; i < height + offset; i++)
+    {
+      if (i >= 0 && i < height)
+        {
+          const guchar *in = src + i * width;
+
+          for (x = 0; x < width; x++)
+            sums[x] += in[x];
+        }
+
+      if (i >= offset)
+        {
+          guchar *out = dst + (i - offset) * width;
+
+          if (i >= d)
+            {
+              const guchar *in = src + (i - d) * width;
+
+              for (x = 0; x < width; x++)
+                sums[x] -= in[x];
+            }
+
+          if (mul)
+            {
+              for (x = 0; x < width; x++)
+                out[x] = ((sums[x] + half) * mul) >> RECIPROCAL_SHIFT;
+            }
+          else
+            {
+              for (x = 0; x < width; x++)
+                out[x] = (sums[x] + half) / d;
+            }
+        }
+    }
+}
+
+/* Blurs @buffer vertically, using @tmp_buffer, which has to be as large,
+ * to ping-pong between the passes.
+ */
+static void
+blur_columns (guchar *buffer,
+              guchar *tmp_buffer,
+              int     width,
+              int     height,
+              int     d)
+{
+  guint32 *sums = g_new (guint32, width);
+
+  /* same pass widths as blur_rows() */
+  if (d % 2 == 1)
+    {
+      blur_yspan (tmp_buffer, buffer, sums, width, height, d, 0);
+      blur_yspan (buffer, tmp_buffer, sums, width, height, d, 0);
+      blur_yspan (tmp_buffer, buffer, sums, width, height, d, 0);
+    }
+  else
+    {
+      blur_yspan (tmp_buffer, buffer, sums, width, height, d, 1);
+      blur_yspan (buffer, tmp_buffer, sums, width, height, d, -1);
+      blur_yspan (tmp_buffer, buffer, sums, width, height, d + 1, 0);
+    }
+
+  memcpy (buffer, tmp_buffer, width * height);
+
+  g_free (sums);
 }
 
 static void
@@ -151,23 +235,17 @@ _boxblur (guchar  *buffer,
           int      height,
           int      radius)
 {
-  guchar *flipped_buffer;
-
-  flipped_buffer = g_malloc (width * height);
-
-  /* Step 1: swap rows and columns */
-  flip_buffer (flipped_buffer, buffer, width, height);
+  guchar *tmp_buffer;
 
-  /* Step 2: blur rows (really columns) */
-  blur_rows (flipped_buffer, buffer, height, width, radius);
+  tmp_buffer = g_malloc (width * height);
 
-  /* Step 3: swap rows and columns */
-  flip_buffer (buffer, flipped_buffer, height, width);
+  /* Step 1: blur columns */
+  blur_columns (buffer, tmp_buffer, width, height, radius);
 
-  /* Step 4: blur rows */
-  blur_rows (buffer, flipped_buffer, width, height, radius);
+  /* Step 2: blur rows */
+  blur_rows (buffer, tmp_buffer, width, height, radius);
 
-  g_free (flipped_buffer);
+  g_free (tmp_buffer);
 }
 
 static const cairo_user_data_key_t original_cr_key;
@@ -68,6 +68,12 @@ main(int argc, char **argv)
     g_type_init();
 #endif
 
+#if !GLIB_CHECK_VERSION (2, 32, 0)
+    /* backdrops are decoded in a thread pool */
+    if(!g_thread_supported())
+        g_thread_init(NULL);
+#endif
+
 #ifdef G_ENABLE_DEBUG
     /* do NOT remove this line. If something doesn't work,
      * fix your code instead! */
@@ -0,0 +1,579 @@
+/*
+ *  xfdesktop - xfce4's desktop manager
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software Foundation,
+ *  Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+/* A process-wide cache of finished backdrops.  Every workspace and monitor
+ * has its own XfceBackdrop, but they very often show the same image at the
+ * same size, so the composited result is shared between them instead of
+ * being decoded and held once per backdrop.
+ *
+ * Entries are keyed by a string describing everything that affects the
+ * result (see xfce_backdrop_image_data_get_cache_key()).  Each entry counts
+ * how many backdrops are currently using it; entries nobody uses are kept
+ * around in LRU order until the cache grows past its maximum size.  The
+ * cache is used from the backdrop worker threads, so all access goes
+ * through cache_lock.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+#ifdef HAVE_SYS_TYPES_H
+#include <sys/types.h>
+#endif
+#ifdef HAVE_SYS_STAT_H
+#include <sys/stat.h>
+#endif
+
+#ifdef HAVE_TIME_H
+#include <time.h>
+#endif
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+#include <cairo.h>
+
+#include <libxfce4util/libxfce4util.h> /* for DBG/TRACE */
+
+#include "xfdesktop-common.h"
+#include "xfce-backdrop-cache.h"
+
+typedef struct
+{
+    gchar *key;
+    cairo_surface_t *surface;
+    gsize size;
+
+    /* number of backdrops using surface, the entry is only in the LRU list
+     * while this is 0 */
+    guint users;
+    GList *lru_link;
+} XfceBackdropCacheEntry;
+
+G_LOCK_DEFINE_STATIC(cache_lock);
+
+/* key -> entry, owns the entries */
+static GHashTable *cache_by_key = NULL;
+/* surface -> entry */
+static GHashTable *cache_by_surface = NULL;
+/* unused entries, most recently released first */
+static GQueue cache_lru = G_QUEUE_INIT;
+
+static gsize cache_size = 0;
+static gsize cache_max_size = XFCE_BACKDROP_CACHE_DEFAULT_SIZE * 1024 * 1024;
+
+
+static void
+xfce_backdrop_cache_entry_free(XfceBackdropCacheEntry *entry)
+{
+    g_free(entry->key);
+    cairo_surface_destroy(entry->surface);
+    g_slice_free(XfceBackdropCacheEntry, entry);
+}
+
+static void
+xfce_backdrop_cache_ensure(void)
+{
+    if(G_LIKELY(cache_by_key != NULL))
+        return;
+
+    cache_by_key = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+                                         (GDestroyNotify)xfce_backdrop_cache_entry_free);
+    cache_by_surface = g_hash_table_new(g_direct_hash, g_direct_equal);
+}
+
+/* Drops unused entries, oldest first, until we fit.  Entries that are in
+ * use are never evicted; their memory is held by the backdrops anyway.
+ * Must be called with cache_lock held. */
+static void
+xfce_backdrop_cache_trim(void)
+{
+    XfceBackdropCacheEntry *entry;
+
+    while(cache_size > cache_max_size
+          && (entry = g_queue_pop_tail(&cache_lru)) != NULL)
+    {
+        XF_DEBUG("evicting %s", entry->key);
+
+        cache_size -= entry->size;
+        g_hash_table_remove(cache_by_surface, entry->surface);
+        g_hash_table_remove(cache_by_key, entry->key);
+    }
+}
+
+/* Must be called with cache_lock held */
+static cairo_surface_t *
+xfce_backdrop_cache_entry_use(XfceBackdropCacheEntry *entry)
+{
+    if(entry->users++ == 0) {
+        g_queue_delete_link(&cache_lru, entry->lru_link);
+        entry->lru_link = NULL;
+    }
+
+    return cairo_surface_reference(entry->surface);
+}
+
+/**
+ * xfce_backdrop_cache_lookup:
+ * @key: The cache key of the backdrop.
+ *
+ * Looks up a finished backdrop.  The caller becomes a user of the entry
+ * until it calls xfce_backdrop_cache_release() on the returned surface.
+ *
+ * Return value: A new reference to the cached surface or %NULL.
+ **/
+cairo_surface_t *
+xfce_backdrop_cache_lookup(const gchar *key)
+{
+    XfceBackdropCacheEntry *entry;
+    cairo_surface_t *surface = NULL;
+
+    g_return_val_if_fail(key != NULL, NULL);
+
+    G_LOCK(cache_lock);
+
+    xfce_backdrop_cache_ensure();
+
+    entry = g_hash_table_lookup(cache_by_key, key);
+    if(entry)
+        surface = xfce_backdrop_cache_entry_use(entry);
+
+    G_UNLOCK(cache_lock);
+
+    XF_DEBUG("%s: %s", surface ? "hit" : "miss", key);
+
+    return surface;
+}
+
+/**
+ * xfce_backdrop_cache_insert:
+ * @key: The cache key of the backdrop.
+ * @surface: The finished backdrop, an image surface.
+ *
+ * Adds @surface to the cache.  If another thread already added a backdrop
+ * for @key, that one is returned instead so both share the same surface.
+ * As with xfce_backdrop_cache_lookup(), the caller becomes a user of the
+ * entry.
+ *
+ * Return value: A new reference to the cached surface.
+ **/
+cairo_surface_t *
+xfce_backdrop_cache_insert(const gchar *key,
+                           cairo_surface_t *surface)
+{
+    XfceBackdropCacheEntry *entry;
+    cairo_surface_t *ret;
+
+    g_return_val_if_fail(key != NULL && surface != NULL, NULL);
+
+    G_LOCK(cache_lock);
+
+    xfce_backdrop_cache_ensure();
+
+    entry = g_hash_table_lookup(cache_by_key, key);
+    if(!entry) {
+        entry = g_slice_new0(XfceBackdropCacheEntry);
+        entry->key = g_strdup(key);
+        entry->surface = cairo_surface_reference(surface);
+        entry->size = (gsize)cairo_image_surface_get_stride(surface)
+                      * cairo_image_surface_get_height(surface);
+
+        /* start out unused so _entry_use() can handle it like the rest */
+        g_queue_push_head(&cache_lru, entry);
+        entry->lru_link = g_queue_peek_head_link(&cache_lru);
+
+        g_hash_table_insert(cache_by_key, entry->key, entry);
+        g_hash_table_insert(cache_by_surface, entry->surface, entry);
+        cache_size += entry->size;
+    }
+
+    ret = xfce_backdrop_cache_entry_use(entry);
+
+    xfce_backdrop_cache_trim();
+
+    G_UNLOCK(cache_lock);
+
+    return ret;
+}
+
+/**
+ * xfce_backdrop_cache_release:
+ * @surface: A surface returned by xfce_backdrop_cache_lookup() or
+ *           xfce_backdrop_cache_insert().
+ *
+ * Stops using @surface and drops the reference to it.  It's safe to call
+ * this on surfaces which are not in the cache, they are simply destroyed.
+ **/
+void
+xfce_backdrop_cache_release(cairo_surface_t *surface)
+{
+    XfceBackdropCacheEntry *entry = NULL;
+
+    g_return_if_fail(surface != NULL);
+
+    G_LOCK(cache_lock);
+
+    if(cache_by_surface)
+        entry = g_hash_table_lookup(cache_by_surface, surface);
+
+    if(entry && entry->users > 0 && --entry->users == 0) {
+        g_queue_push_head(&cache_lru, entry);
+        entry->lru_link = g_queue_peek_head_link(&cache_lru);
+        xfce_backdrop_cache_trim();
+    }
+
+    G_UNLOCK(cache_lock);
+
+    cairo_surface_destroy(surface);
+}
+
+/**
+ * xfce_backdrop_cache_set_max_size:
+ * @max_size: The maximum size in bytes.
+ *
+ * Sets how much memory the cache may hold on to.  Backdrops in use are
+ * always kept, so this only limits how many unused backdrops are kept
+ * around.  A @max_size of 0 disables keeping unused backdrops.
+ **/
+void
+xfce_backdrop_cache_set_max_size(gsize max_size)
+{
+    G_LOCK(cache_lock);
+
+    cache_max_size = max_size;
+    if(cache_by_key)
+        xfce_backdrop_cache_trim();
+
+    G_UNLOCK(cache_lock);
+}
+
+
+/* The on-disk cache keeps the finished backdrops around across sessions so
+ * that a login can paint the wallpaper without decoding the source image.
+ * Files are named after a checksum of the cache key and contain a small
+ * header, the key itself and the raw surface rows in cairo's native format,
+ * so they can simply be mmap()ed and painted without any conversion.  The
+ * header records the mtime and size of the source image the backdrop was
+ * made from; if either changed the entry is stale and gets overwritten the
+ * next time the backdrop is rendered. */
+
+#define XFCE_BACKDROP_DISK_CACHE_MAGIC   0x43424658  /* "XFBC" */
+#define XFCE_BACKDROP_DISK_CACHE_VERSION 2
+#define XFCE_BACKDROP_DISK_CACHE_SIZE    (256 * 1024 * 1024)
+
+typedef struct
+{
+    guint32 magic;
+    guint32 version;
+    gint64 source_mtime;
+    gint64 source_size;
+    guint32 width;
+    guint32 height;
+    guint32 stride;
+    guint32 format;
+    guint32 key_len;
+    guint32 data_offset;
+} XfceBackdropDiskCacheHeader;
+
+G_LOCK_DEFINE_STATIC(disk_cache_lock);
+
+static gchar *
+xfce_backdrop_disk_cache_get_dir(void)
+{
+    return g_build_filename(g_get_user_cache_dir(), "xfdesktop", "backdrops",
+                            NULL);
+}
+
+static gchar *
+xfce_backdrop_disk_cache_get_filename(const gchar *key)
+{
+    gchar *dir, *checksum, *basename, *filename;
+
+    dir = xfce_backdrop_disk_cache_get_dir();
+    checksum = g_compute_checksum_for_string(G_CHECKSUM_SHA1, key, -1);
+    basename = g_strconcat(checksum, ".raw", NULL);
+    filename = g_build_filename(dir, basename, NULL);
+
+    g_free(basename);
+    g_free(checksum);
+    g_free(dir);
+
+    return filename;
+}
+
+static const cairo_user_data_key_t xfce_backdrop_disk_cache_mapping;
+
+/**
+ * xfce_backdrop_cache_load_file:
+ * @key: The cache key of the backdrop.
+ * @source_mtime: The mtime of the source image.
+ * @source_size: The size of the source image.
+ *
+ * Looks for a finished backdrop in the on-disk cache.  The returned surface
+ * is backed by a private mapping of the cache file.  Can be called from
+ * any thread.
+ *
+ * Return value: A new image surface or %NULL if there is no valid cache
+ *               entry.
+ **/
+cairo_surface_t *
+xfce_backdrop_cache_load_file(const gchar *key,
+                              gint64 source_mtime,
+                              gint64 source_size)
+{
+    gchar *filename;
+    GMappedFile *mapped;
+    const XfceBackdropDiskCacheHeader *header;
+    const gchar *contents;
+    gsize length, key_len;
+    cairo_surface_t *surface;
+
+    g_return_val_if_fail(key != NULL, NULL);
+
+    filename = xfce_backdrop_disk_cache_get_filename(key);
+
+    /* writable only gives us a private copy-on-write mapping, the file
+     * itself is never modified through it */
+    mapped = g_mapped_file_new(filename, TRUE, NULL);
+    if(!mapped) {
+        g_free(filename);
+        return NULL;
+    }
+
+    contents = g_mapped_file_get_contents(mapped);
+    length = g_mapped_file_get_length(mapped);
+    header = (const XfceBackdropDiskCacheHeader *)contents;
+    key_len = strlen(key);
+
+    if(length < sizeof(XfceBackdropDiskCacheHeader)
+       || header->magic != XFCE_BACKDROP_DISK_CACHE_MAGIC
+       || header->version != XFCE_BACKDROP_DISK_CACHE_VERSION
+       || header->source_mtime != source_mtime
+       || header->source_size != source_size
+       || header->key_len != key_len
+       || header->width == 0 || header->height == 0
+       || (header->format != CAIRO_FORMAT_RGB24
+           && header->format != CAIRO_FORMAT_ARGB32)
+       || header->data_offset < sizeof(XfceBackdropDiskCacheHeader) + key_len
+       || (guint64)header->data_offset
+          + (guint64)header->stride * header->height > length
+       || header->stride != (guint32)cairo_format_stride_for_width(header->format,
+                                                                   header->width)
+       || memcmp(contents + sizeof(XfceBackdropDiskCacheHeader), key, key_len) != 0)
+    {
+        XF_DEBUG("stale or invalid cache file %s", filename);
+        g_mapped_file_unref(mapped);
+        g_free(filename);
+        return NULL;
+    }
+
+    surface = cairo_image_surface_create_for_data((guchar *)contents + header->data_offset,
+                                                  header->format,
+                                                  header->width,
+                                                  header->height,
+                                                  header->stride);
+
+    /* the surface doesn't own its data, so keep the mapping around for as
+     * long as the surface lives */
+    if(cairo_surface_status(surface) != CAIRO_STATUS_SUCCESS
+       || cairo_surface_set_user_data(surface,
+                                      &xfce_backdrop_disk_cache_mapping,
+                                      mapped,
+                                      (cairo_destroy_func_t)g_mapped_file_unref)
+          != CAIRO_STATUS_SUCCESS)
+    {
+        cairo_surface_destroy(surface);
+        g_mapped_file_unref(mapped);
+        g_free(filename);
+        return NULL;
+    }
+
+    /* mark it as recently used so pruning keeps it */
+    g_utime(filename, NULL);
+
+    XF_DEBUG("loaded %s from %s", key, filename);
+
+    g_free(filename);
+
+    return surface;
+}
+
+/* Keeps the on-disk cache below XFCE_BACKDROP_DISK_CACHE_SIZE by removing
+ * the least recently used files.  Must be called with disk_cache_lock held. */
+static void
+xfce_backdrop_disk_cache_prune(const gchar *dir_name)
+{
+    GDir *dir;
+    const gchar *name;
+    GPtrArray *files;
+    GStatBuf st;
+    guint64 total = 0;
+    guint i, j;
+
+    dir = g_dir_open(dir_name, 0, NULL);
+    if(!dir)
+        return;
+
+    files = g_ptr_array_new_with_free_func(g_free);
+
+    while((name = g_dir_read_name(dir))) {
+        gchar *filename;
+
+        if(!g_str_has_suffix(name, ".raw"))
+            continue;
+
+        filename = g_build_filename(dir_name, name, NULL);
+        if(g_stat(filename, &st) == 0) {
+            total += st.st_size;
+            g_ptr_array_add(files, filename);
+        } else
+            g_free(filename);
+    }
+
+    g_dir_close(dir);
+
+    /* the directory only ever holds a handful of files, so simply
+     * remove the oldest one until we fit */
+    while(total > XFCE_BACKDROP_DISK_CACHE_SIZE && files->len > 0) {
+        guint oldest = 0;
+        time_t oldest_mtime = 0;
+        goffset oldest_size = 0;
+
+        for(i = 0, j = 0; i < files->len; i++) {
+            if(g_stat(g_ptr_array_index(files, i), &st) != 0)
+                continue;
+            if(j++ == 0 || st.st_mtime < oldest_mtime) {
+                oldest = i;
+                oldest_mtime = st.st_mtime;
+                oldest_size = st.st_size;
+            }
+        }
+
+        XF_DEBUG("pruning %s", (gchar *)g_ptr_array_index(files, oldest));
+
+        g_unlink(g_ptr_array_index(files, oldest));
+        g_ptr_array_remove_index_fast(files, oldest);
+        total -= oldest_size;
+    }
+
+    g_ptr_array_free(files, TRUE);
+}
+
+/**
+ * xfce_backdrop_cache_save_file:
+ * @key: The cache key of the backdrop.
+ * @source_mtime: The mtime of the source image.
+ * @source_size: The size of the source image.
+ * @surface: The finished backdrop, an image surface.
+ *
+ * Writes @surface to the on-disk cache, replacing any older entry for @key.
+ * This does blocking I/O and is meant to be called from the backdrop
+ * worker threads.
+ **/
+void
+xfce_backdrop_cache_save_file(const gchar *key,
+                              gint64 source_mtime,
+                              gint64 source_size,
+                              cairo_surface_t *surface)
+{
+    XfceBackdropDiskCacheHeader header = { 0, };
+    gchar *dir, *filename;
+    GFile *file;
+    GFileOutputStream *stream;
+    GOutputStream *out;
+    const guchar *pixels;
+    guchar padding[16] = { 0, };
+    gsize key_len;
+    gboolean ok;
+
+    g_return_if_fail(key != NULL && surface != NULL);
+
+    dir = xfce_backdrop_disk_cache_get_dir();
+    if(g_mkdir_with_parents(dir, 0700) != 0) {
+        g_free(dir);
+        return;
+    }
+
+    filename = xfce_backdrop_disk_cache_get_filename(key);
+    key_len = strlen(key);
+
+    header.magic = XFCE_BACKDROP_DISK_CACHE_MAGIC;
+    header.version = XFCE_BACKDROP_DISK_CACHE_VERSION;
+    header.source_mtime = source_mtime;
+    header.source_size = source_size;
+    header.width = cairo_image_surface_get_width(surface);
+    header.height = cairo_image_surface_get_height(surface);
+    header.stride = cairo_image_surface_get_stride(surface);
+    header.format = cairo_image_surface_get_format(surface);
+    header.key_len = key_len;
+    /* keep the pixel data nicely aligned in the mapping */
+    header.data_offset = (sizeof(header) + key_len + 15) & ~15;
+
+    /* make sure nothing is still pending on the surface */
+    cairo_surface_flush(surface);
+    pixels = cairo_image_surface_get_data(surface);
+
+    G_LOCK(disk_cache_lock);
+
+    /* g_file_replace() writes to a temporary file and renames it over the
+     * old one, so readers never see a half written entry */
+    file = g_file_new_for_path(filename);
+    stream = g_file_replace(file, NULL, FALSE, G_FILE_CREATE_PRIVATE,
+                            NULL, NULL);
+    if(stream) {
+        out = G_OUTPUT_STREAM(stream);
+
+        ok = g_output_stream_write_all(out, &header, sizeof(header),
+                                       NULL, NULL, NULL)
+             && g_output_stream_write_all(out, key, key_len,
+                                          NULL, NULL, NULL)
+             && g_output_stream_write_all(out, padding,
+                                          header.data_offset - sizeof(header) - key_len,
+                                          NULL, NULL, NULL)
+             && g_output_stream_write_all(out, pixels,
+                                          (gsize)header.stride * header.height,
+                                          NULL, NULL, NULL);
+
+        /* closing the stream is what renames the temporary file, so
+         * cancel that if anything went wrong */
+        if(!ok) {
+            GCancellable *cancellable = g_cancellable_new();
+            g_cancellable_cancel(cancellable);
+            g_output_stream_close(out, cancellable, NULL);
+            g_object_unref(cancellable);
+        } else
+            g_output_stream_close(out, NULL, NULL);
+
+        g_object_unref(stream);
+
+        XF_DEBUG("saved %s to %s", key, filename);
+    }
+    g_object_unref(file);
+
+    xfce_backdrop_disk_cache_prune(dir);
+
+    G_UNLOCK(disk_cache_lock);
+
+    g_free(filename);
+    g_free(dir);
+}
@@ -0,0 +1,49 @@
+/*
+ *  xfdesktop - xfce4's desktop manager
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software Foundation,
+ *  Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#ifndef _XFCE_BACKDROP_CACHE_H_
+#define _XFCE_BACKDROP_CACHE_H_
+
+#include <glib.h>
+#include <cairo.h>
+
+G_BEGIN_DECLS
+
+#define XFCE_BACKDROP_CACHE_DEFAULT_SIZE 64  /* MiB */
+
+cairo_surface_t *xfce_backdrop_cache_lookup    (const gchar *key);
+
+cairo_surface_t *xfce_backdrop_cache_insert    (const gchar *key,
+                                                cairo_surface_t *surface);
+
+void xfce_backdrop_cache_release               (cairo_surface_t *surface);
+
+void xfce_backdrop_cache_set_max_size          (gsize max_size);
+
+cairo_surface_t *xfce_backdrop_cache_load_file (const gchar *key,
+                                                gint64 source_mtime,
+                                                gint64 source_size);
+
+void xfce_backdrop_cache_save_file             (const gchar *key,
+                                                gint64 source_mtime,
+                                                gint64 source_size,
+                                                cairo_surface_t *surface);
+
+G_END_DECLS
+
+#endif
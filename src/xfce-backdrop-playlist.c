@@ -0,0 +1,308 @@
+/*
+ *  xfdesktop - xfce4's desktop manager
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software Foundation,
+ *  Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+/* The list of images a backdrop cycles through.  The images are kept in an
+ * array sorted the same way xfdesktop-settings displays them, with the
+ * collate key of every file computed once when it is added.  A hash table
+ * maps each path to its position, so finding the current image, picking
+ * the next one or a random one are all O(1) no matter how many images are
+ * in the directory.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+#include <glib.h>
+
+#include "xfce-backdrop-playlist.h"
+
+typedef struct
+{
+    gchar *path;
+    gchar *collate_key;
+    guint index;
+} XfceBackdropPlaylistEntry;
+
+struct _XfceBackdropPlaylist
+{
+    /* sorted by collate key */
+    GPtrArray *entries;
+    /* path -> entry */
+    GHashTable *by_path;
+};
+
+
+static XfceBackdropPlaylistEntry *
+xfce_backdrop_playlist_entry_new(const gchar *path)
+{
+    XfceBackdropPlaylistEntry *entry = g_slice_new(XfceBackdropPlaylistEntry);
+
+    entry->path = g_strdup(path);
+    /* we compare by the collate key so the image listing is the same as
+     * how xfdesktop-settings displays the images */
+    entry->collate_key = g_utf8_collate_key_for_filename(path, -1);
+    entry->index = 0;
+
+    return entry;
+}
+
+static void
+xfce_backdrop_playlist_entry_free(XfceBackdropPlaylistEntry *entry)
+{
+    g_free(entry->path);
+    g_free(entry->collate_key);
+    g_slice_free(XfceBackdropPlaylistEntry, entry);
+}
+
+static gint
+xfce_backdrop_playlist_entry_compare(const XfceBackdropPlaylistEntry *a,
+                                     const XfceBackdropPlaylistEntry *b)
+{
+    gint ret = strcmp(a->collate_key, b->collate_key);
+
+    /* keep the order stable for names that collate the same */
+    if(ret == 0)
+        ret = strcmp(a->path, b->path);
+
+    return ret;
+}
+
+static gint
+xfce_backdrop_playlist_entry_compare_indirect(gconstpointer a,
+                                              gconstpointer b)
+{
+    return xfce_backdrop_playlist_entry_compare(*(XfceBackdropPlaylistEntry **)a,
+                                                *(XfceBackdropPlaylistEntry **)b);
+}
+
+/* Updates the positions stored in the entries from @first on */
+static void
+xfce_backdrop_playlist_reindex(XfceBackdropPlaylist *playlist,
+                               guint first)
+{
+    guint i;
+
+    for(i = first; i < playlist->entries->len; i++) {
+        XfceBackdropPlaylistEntry *entry = g_ptr_array_index(playlist->entries, i);
+        entry->index = i;
+    }
+}
+
+XfceBackdropPlaylist *
+xfce_backdrop_playlist_new(void)
+{
+    XfceBackdropPlaylist *playlist = g_slice_new(XfceBackdropPlaylist);
+
+    playlist->entries = g_ptr_array_new();
+    playlist->by_path = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+                                              (GDestroyNotify)xfce_backdrop_playlist_entry_free);
+
+    return playlist;
+}
+
+void
+xfce_backdrop_playlist_free(XfceBackdropPlaylist *playlist)
+{
+    if(!playlist)
+        return;
+
+    g_ptr_array_free(playlist->entries, TRUE);
+    g_hash_table_destroy(playlist->by_path);
+    g_slice_free(XfceBackdropPlaylist, playlist);
+}
+
+/**
+ * xfce_backdrop_playlist_add:
+ * @playlist: An #XfceBackdropPlaylist.
+ * @path: The image file to add.
+ *
+ * Inserts @path at its sorted position.  Meant for single files showing
+ * up, use xfce_backdrop_playlist_add_many() to add a lot of them.
+ *
+ * Return value: %TRUE if @path was added, %FALSE if it was already there.
+ **/
+gboolean
+xfce_backdrop_playlist_add(XfceBackdropPlaylist *playlist,
+                           const gchar *path)
+{
+    XfceBackdropPlaylistEntry *entry;
+    guint low, high, mid;
+
+    g_return_val_if_fail(playlist != NULL && path != NULL, FALSE);
+
+    if(g_hash_table_lookup(playlist->by_path, path))
+        return FALSE;
+
+    entry = xfce_backdrop_playlist_entry_new(path);
+
+    /* find the first entry sorting after the new one */
+    low = 0;
+    high = playlist->entries->len;
+    while(low < high) {
+        mid = low + (high - low) / 2;
+        if(xfce_backdrop_playlist_entry_compare(g_ptr_array_index(playlist->entries, mid),
+                                                entry) < 0)
+        {
+            low = mid + 1;
+        } else
+            high = mid;
+    }
+
+    /* GPtrArray can only append, so make room and shift the tail */
+    g_ptr_array_add(playlist->entries, NULL);
+    memmove(&playlist->entries->pdata[low + 1], &playlist->entries->pdata[low],
+            (playlist->entries->len - 1 - low) * sizeof(gpointer));
+    playlist->entries->pdata[low] = entry;
+
+    g_hash_table_insert(playlist->by_path, entry->path, entry);
+    xfce_backdrop_playlist_reindex(playlist, low);
+
+    return TRUE;
+}
+
+/**
+ * xfce_backdrop_playlist_add_many:
+ * @playlist: An #XfceBackdropPlaylist.
+ * @paths: The image files to add.
+ * @n_paths: The number of entries in @paths.
+ *
+ * Adds all of @paths that aren't in @playlist yet and sorts the result
+ * once, which is a lot cheaper than inserting them one by one.  The
+ * strings are copied.
+ *
+ * Return value: The number of paths that were added.
+ **/
+guint
+xfce_backdrop_playlist_add_many(XfceBackdropPlaylist *playlist,
+                                gchar **paths,
+                                guint n_paths)
+{
+    guint i, n_added = 0;
+
+    g_return_val_if_fail(playlist != NULL, 0);
+
+    for(i = 0; i < n_paths; i++) {
+        XfceBackdropPlaylistEntry *entry;
+
+        if(g_hash_table_lookup(playlist->by_path, paths[i]))
+            continue;
+
+        entry = xfce_backdrop_playlist_entry_new(paths[i]);
+        g_ptr_array_add(playlist->entries, entry);
+        g_hash_table_insert(playlist->by_path, entry->path, entry);
+        n_added++;
+    }
+
+    if(n_added > 0) {
+        g_ptr_array_sort(playlist->entries,
+                         xfce_backdrop_playlist_entry_compare_indirect);
+        xfce_backdrop_playlist_reindex(playlist, 0);
+    }
+
+    return n_added;
+}
+
+/**
+ * xfce_backdrop_playlist_remove:
+ * @playlist: An #XfceBackdropPlaylist.
+ * @path: The image file to remove.
+ *
+ * Return value: %TRUE if @path was removed, %FALSE if it wasn't there.
+ **/
+gboolean
+xfce_backdrop_playlist_remove(XfceBackdropPlaylist *playlist,
+                              const gchar *path)
+{
+    XfceBackdropPlaylistEntry *entry;
+    guint index;
+
+    g_return_val_if_fail(playlist != NULL && path != NULL, FALSE);
+
+    entry = g_hash_table_lookup(playlist->by_path, path);
+    if(!entry)
+        return FALSE;
+
+    index = entry->index;
+    g_ptr_array_remove_index(playlist->entries, index);
+    /* frees the entry */
+    g_hash_table_remove(playlist->by_path, path);
+    xfce_backdrop_playlist_reindex(playlist, index);
+
+    return TRUE;
+}
+
+guint
+xfce_backdrop_playlist_get_length(XfceBackdropPlaylist *playlist)
+{
+    g_return_val_if_fail(playlist != NULL, 0);
+
+    return playlist->entries->len;
+}
+
+/**
+ * xfce_backdrop_playlist_get_nth:
+ * @playlist: An #XfceBackdropPlaylist.
+ * @n: A position in @playlist.
+ *
+ * Return value: The path at position @n, owned by @playlist, or %NULL if
+ *               @n is out of range.
+ **/
+const gchar *
+xfce_backdrop_playlist_get_nth(XfceBackdropPlaylist *playlist,
+                               guint n)
+{
+    XfceBackdropPlaylistEntry *entry;
+
+    g_return_val_if_fail(playlist != NULL, NULL);
+
+    if(n >= playlist->entries->len)
+        return NULL;
+
+    entry = g_ptr_array_index(playlist->entries, n);
+
+    return entry->path;
+}
+
+/**
+ * xfce_backdrop_playlist_index_of:
+ * @playlist: An #XfceBackdropPlaylist.
+ * @path: An image file.
+ *
+ * Return value: The position of @path in @playlist or -1 if it isn't in
+ *               there.
+ **/
+gint
+xfce_backdrop_playlist_index_of(XfceBackdropPlaylist *playlist,
+                                const gchar *path)
+{
+    XfceBackdropPlaylistEntry *entry;
+
+    g_return_val_if_fail(playlist != NULL, -1);
+
+    if(!path)
+        return -1;
+
+    entry = g_hash_table_lookup(playlist->by_path, path);
+
+    return entry ? (gint)entry->index : -1;
+}
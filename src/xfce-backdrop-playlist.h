@@ -0,0 +1,55 @@
+/*
+ *  xfdesktop - xfce4's desktop manager
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software Foundation,
+ *  Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#ifndef _XFCE_BACKDROP_PLAYLIST_H_
+#define _XFCE_BACKDROP_PLAYLIST_H_
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _XfceBackdropPlaylist XfceBackdropPlaylist;
+
+XfceBackdropPlaylist *xfce_backdrop_playlist_new (void);
+
+void xfce_backdrop_playlist_free                 (XfceBackdropPlaylist *playlist);
+
+gboolean xfce_backdrop_playlist_add              (XfceBackdropPlaylist *playlist,
+                                                  const gchar *path);
+
+guint xfce_backdrop_playlist_add_many            (XfceBackdropPlaylist *playlist,
+                                                  gchar **paths,
+                                                  guint n_paths);
+
+gboolean xfce_backdrop_playlist_remove           (XfceBackdropPlaylist *playlist,
+                                                  const gchar *path);
+
+guint xfce_backdrop_playlist_get_length          (XfceBackdropPlaylist *playlist);
+
+const gchar *xfce_backdrop_playlist_get_nth      (XfceBackdropPlaylist *playlist,
+                                                  guint n);
+
+gint xfce_backdrop_playlist_index_of             (XfceBackdropPlaylist *playlist,
+                                                  const gchar *path);
+
+#define xfce_backdrop_playlist_contains(playlist, path) \
+    (xfce_backdrop_playlist_index_of((playlist), (path)) >= 0)
+
+G_END_DECLS
+
+#endif
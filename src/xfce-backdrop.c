@@ -30,14 +30,24 @@
 #include <string.h>
 #endif
 
+#ifdef HAVE_SYS_TYPES_H
+#include <sys/types.h>
+#endif
+#ifdef HAVE_SYS_STAT_H
+#include <sys/stat.h>
+#endif
+
 #include <glib.h>
+#include <glib/gstdio.h>
 #include <gdk/gdk.h>
 #include <gdk-pixbuf/gdk-pixbuf.h>
-#include <gdk-pixbuf/gdk-pixdata.h>
+#include <cairo.h>
 
 #include <libxfce4util/libxfce4util.h> /* for DBG/TRACE */
 
 #include "xfce-backdrop.h"
+#include "xfce-backdrop-cache.h"
+#include "xfce-backdrop-playlist.h"
 #include "xfce-desktop-enum-types.h"
 #include "xfdesktop-common.h"  /* for DEFAULT_BACKDROP */
 
@@ -46,12 +56,16 @@
 #endif
 
 #define XFCE_BACKDROP_BUFFER_SIZE 32768
+#define XFCE_BACKDROP_SCAN_BATCH_SIZE 64
+#define XFCE_BACKDROP_MAX_THREADS 4
 
 #ifndef O_BINARY
 #define O_BINARY  0
 #endif
 
 typedef struct _XfceBackdropImageData XfceBackdropImageData;
+typedef struct _XfceBackdropScan XfceBackdropScan;
+typedef struct _XfceBackdropFileQuery XfceBackdropFileQuery;
 
 static void xfce_backdrop_finalize(GObject *object);
 static void xfce_backdrop_set_property(GObject *object,
@@ -64,25 +78,25 @@ static void xfce_backdrop_get_property(GObject *object,
                                        GParamSpec *pspec);
 static gboolean xfce_backdrop_timer(XfceBackdrop *backdrop);
 
-static GdkPixbuf *xfce_backdrop_generate_canvas(XfceBackdrop *backdrop);
+static GdkPixbuf *xfce_backdrop_generate_canvas(XfceBackdropImageData *image_data);
 
 static void xfce_backdrop_loader_size_prepared_cb(GdkPixbufLoader *loader,
                                                   gint width,
                                                   gint height,
                                                   gpointer user_data);
 
-static void xfce_backdrop_loader_closed_cb(GdkPixbufLoader *loader,
-                                           XfceBackdropImageData *image_data);
-
-static void xfce_backdrop_file_ready_cb(GObject *source_object,
-                                        GAsyncResult *res,
-                                        gpointer user_data);
+static void xfce_backdrop_generate_thread(gpointer data,
+                                          gpointer user_data);
+static gboolean xfce_backdrop_generate_done(gpointer user_data);
 
-static void xfce_backdrop_file_input_stream_ready_cb(GObject *source_object,
-                                                     GAsyncResult *res,
-                                                     gpointer user_data);
+static void xfce_backdrop_cancel_generate(XfceBackdrop *backdrop);
 
 static void xfce_backdrop_image_data_release(XfceBackdropImageData *image_data);
+static void xfce_backdrop_cancel_prefetch(XfceBackdrop *backdrop);
+static gboolean xfce_backdrop_use_prefetch(XfceBackdrop *backdrop);
+static void xfce_backdrop_prefetch_next(XfceBackdrop *backdrop);
+static void xfce_backdrop_cycle_backdrop(XfceBackdrop *backdrop);
+static void xfce_backdrop_release_previous_surface(XfceBackdrop *backdrop);
 
 gchar *xfce_backdrop_choose_next         (XfceBackdrop *backdrop);
 gchar *xfce_backdrop_choose_random       (XfceBackdrop *backdrop);
@@ -93,9 +107,14 @@ struct _XfceBackdropPriv
     gint width, height;
     gint bpp;
 
-    GdkPixbuf *pix;
+    cairo_surface_t *surface;
     XfceBackdropImageData *image_data;
 
+    /* the image the next cycle will switch to, rendered ahead of time */
+    XfceBackdropImageData *prefetch_data;
+    /* what was shown before the last cycle, for the desktop to fade from */
+    cairo_surface_t *previous_surface;
+
     XfceBackdropColorStyle color_style;
     GdkColor color1;
     GdkColor color2;
@@ -103,7 +122,13 @@ struct _XfceBackdropPriv
     XfceBackdropImageStyle image_style;
     gchar *image_path;
     /* Cached list of images in the same folder as image_path */
-    GList *image_files;
+    XfceBackdropPlaylist *image_files;
+    /* the directory scan filling image_files, if it's still running */
+    XfceBackdropScan *scan;
+    /* set when it was time to cycle before the scan was done */
+    gboolean cycle_pending;
+    /* the content type look ups of files created in that directory */
+    GCancellable *file_queries_cancellable;
     /* monitor for the image_files directory */
     GFileMonitor *monitor;
 
@@ -112,17 +137,63 @@ struct _XfceBackdropPriv
     guint cycle_timer_id;
     XfceBackdropCyclePeriod cycle_period;
     gboolean random_backdrop_order;
+
+    /* Random order goes through a shuffled copy of image_files, so every
+     * image is shown once before any is repeated.  Only the seed and how
+     * far along we are get saved, the order is recreated from those. */
+    guint shuffle_seed;
+    guint shuffle_position;
+    guint *shuffle_bag;
+    guint shuffle_bag_len;
 };
 
-struct _XfceBackdropImageData
+/* An asynchronous scan of the directory image_path is in.  It outlives the
+ * backdrop if it gets canceled, in which case backdrop is NULL. */
+struct _XfceBackdropScan
 {
     XfceBackdrop *backdrop;
+    GCancellable *cancellable;
+    gchar *dir_name;
+};
 
-    GdkPixbufLoader *loader;
+/* The content type look up of a file that showed up in the directory of
+ * image_path.  Once cancellable is canceled, backdrop may be gone. */
+struct _XfceBackdropFileQuery
+{
+    XfceBackdrop *backdrop;
+    GCancellable *cancellable;
+    gchar *path;
+};
+
+/* A single request to generate the backdrop.  Everything the worker thread
+ * needs is copied in here when the request is queued so that it never has
+ * to touch backdrop->priv, which belongs to the main thread. */
+struct _XfceBackdropImageData
+{
+    /* NULL once the request has been superseded or the backdrop finalized */
+    XfceBackdrop *backdrop;
 
     GCancellable *cancellable;
 
-    guchar *image_buffer;
+    gchar *image_path;
+    gint width, height;
+    gint bpp;
+    XfceBackdropColorStyle color_style;
+    GdkColor color1;
+    GdkColor color2;
+    XfceBackdropImageStyle image_style;
+
+    /* set when the loader only did the cheap part of the scaling and the
+     * rest has to be done while compositing */
+    gboolean dct_scaled;
+
+    /* the finished backdrop, handed back to the main thread */
+    cairo_surface_t *surface;
+
+    /* prefetch requests are kept around once finished instead of
+     * replacing the backdrop's surface */
+    gboolean prefetch;
+    gboolean finished;
 };
 
 enum
@@ -146,10 +217,15 @@ enum
     PROP_BACKDROP_CYCLE_PERIOD,
     PROP_BACKDROP_CYCLE_TIMER,
     PROP_BACKDROP_RANDOM_ORDER,
+    PROP_BACKDROP_SHUFFLE_SEED,
+    PROP_BACKDROP_SHUFFLE_POSITION,
 };
 
 static guint backdrop_signals[LAST_SIGNAL] = { 0, };
 
+/* decodes, scales and composites backdrops off the main thread */
+static GThreadPool *backdrop_thread_pool = NULL;
+
 /* helper functions */
 
 static GdkPixbuf *
@@ -172,63 +248,148 @@ create_solid(GdkColor *color,
     return pix;
 }
 
+/* 4x4 ordered dither matrix */
+static const guint8 gradient_dither_matrix[4][4] = {
+    {  0,  8,  2, 10 },
+    { 12,  4, 14,  6 },
+    {  3, 11,  1,  9 },
+    { 15,  7, 13,  5 },
+};
+
+/* Returns the distance between the levels the X server will actually be
+ * able to display per color channel for a visual of depth @bpp, or 1 if
+ * it can display all 256 */
+static gint
+gradient_dither_step(gint bpp)
+{
+    if(bpp >= 24 || bpp <= 0)
+        return 1;
+
+    return 1 << (8 - MAX(bpp / 3, 1));
+}
+
+/* @value is a 16 bit channel value with 8 extra fractional bits.  Without
+ * dithering this just truncates it to 8 bits, which is what we always
+ * did; otherwise it's dithered down to a multiple of @step. */
+static inline guint8
+gradient_channel(gint32 value,
+                 gint threshold,
+                 gint step)
+{
+    gint v = value >> 8;
+
+    if(step == 1)
+        return v >> 8;
+
+    /* threshold is 0..15, spread it over (0, step) in 16 bit units */
+    v = (v + (2 * threshold + 1) * step * 8) >> 8;
+
+    return MIN(v, 255) & ~(step - 1);
+}
+
+/* Fills a row of @row_len bytes with a repeating @pattern_len byte pattern
+ * that is already at the start of @row.  Doubling the copy each time
+ * leaves the heavy lifting to memcpy(). */
+static void
+gradient_fill_row(guchar *row,
+                  gsize pattern_len,
+                  gsize row_len)
+{
+    gsize filled = pattern_len;
+
+    while(filled < row_len) {
+        gsize n = MIN(filled, row_len - filled);
+        memcpy(row + filled, row, n);
+        filled += n;
+    }
+}
+
 static GdkPixbuf *
 create_gradient(GdkColor *color1, GdkColor *color2, gint width, gint height,
-        XfceBackdropColorStyle style)
+        XfceBackdropColorStyle style, gint bpp)
 {
     GdkPixbuf *pix;
-    gint i, j;
-    GdkPixdata pixdata;
-    guint8 rgb[3];
-    GError *err = NULL;
-    
+    guchar *pixels, *row;
+    gint rowstride, row_len;
+    gint i, j, len, period, step;
+    gint32 r, g, b, dr, dg, db;
+
     g_return_val_if_fail(color1 != NULL && color2 != NULL, NULL);
     g_return_val_if_fail(width > 0 && height > 0, NULL);
     g_return_val_if_fail(style == XFCE_BACKDROP_COLOR_HORIZ_GRADIENT
             || style == XFCE_BACKDROP_COLOR_VERT_GRADIENT, NULL);
-    
-    pixdata.magic = GDK_PIXBUF_MAGIC_NUMBER;
-    pixdata.length = GDK_PIXDATA_HEADER_LENGTH + (width * height * 3);
-    pixdata.pixdata_type = GDK_PIXDATA_COLOR_TYPE_RGB
-            | GDK_PIXDATA_SAMPLE_WIDTH_8 | GDK_PIXDATA_ENCODING_RAW;
-    pixdata.rowstride = width * 3;
-    pixdata.width = width;
-    pixdata.height = height;
-    pixdata.pixel_data = g_malloc(width * height * 3);
+
+    /* written straight into the pixbuf, no intermediate copies */
+    pix = gdk_pixbuf_new(GDK_COLORSPACE_RGB, FALSE, 8, width, height);
+    if(!pix) {
+        g_warning("%s: Unable to create color gradient\n", PACKAGE);
+        return NULL;
+    }
+
+    pixels = gdk_pixbuf_get_pixels(pix);
+    rowstride = gdk_pixbuf_get_rowstride(pix);
+    row_len = width * 3;
+
+    /* on low depth visuals dither instead of letting the X server band
+     * the gradient; the dither pattern repeats every 4 pixels */
+    step = gradient_dither_step(bpp);
+    period = step > 1 ? 4 : 1;
+
+    len = style == XFCE_BACKDROP_COLOR_HORIZ_GRADIENT ? width : height;
+
+    /* fixed point stepping with 8 fractional bits; the same as
+     * color1 + (i * (color2 - color1) / len) without the divisions */
+    r = color1->red << 8;
+    g = color1->green << 8;
+    b = color1->blue << 8;
+    dr = (gint32)(color2->red - color1->red) * 256 / len;
+    dg = (gint32)(color2->green - color1->green) * 256 / len;
+    db = (gint32)(color2->blue - color1->blue) * 256 / len;
 
     if(style == XFCE_BACKDROP_COLOR_HORIZ_GRADIENT) {
-        for(i = 0; i < width; i++) {
-            rgb[0] = (color1->red + (i * (color2->red - color1->red) / width)) >> 8;
-            rgb[1] = (color1->green + (i * (color2->green - color1->green) / width)) >> 8;
-            rgb[2] = (color1->blue + (i * (color2->blue - color1->blue) / width)) >> 8;
-            memcpy(pixdata.pixel_data+(i*3), rgb, 3);
+        /* only the first few rows differ (by their dither pattern) */
+        for(j = 0; j < MIN(period, height); j++) {
+            gint32 cr = r, cg = g, cb = b;
+
+            row = pixels + j * rowstride;
+            for(i = 0; i < width; i++) {
+                gint t = gradient_dither_matrix[j & 3][i & 3];
+
+                row[i * 3] = gradient_channel(cr, t, step);
+                row[i * 3 + 1] = gradient_channel(cg, t, step);
+                row[i * 3 + 2] = gradient_channel(cb, t, step);
+
+                cr += dr;
+                cg += dg;
+                cb += db;
+            }
         }
-        
-        for(i = 1; i < height; i++) {
-            memcpy(pixdata.pixel_data+(i*pixdata.rowstride),
-                    pixdata.pixel_data, pixdata.rowstride);
+
+        for(j = period; j < height; j++) {
+            memcpy(pixels + j * rowstride,
+                   pixels + (j % period) * rowstride,
+                   row_len);
         }
-    } else if(XFCE_BACKDROP_COLOR_TRANSPARENT == style)
-        memset(pixdata.pixel_data, 0x0, width * height * 3);
-    else {
-        for(i = 0; i < height; i++) {
-            rgb[0] = (color1->red + (i * (color2->red - color1->red) / height)) >> 8;
-            rgb[1] = (color1->green + (i * (color2->green - color1->green) / height)) >> 8;
-            rgb[2] = (color1->blue + (i * (color2->blue - color1->blue) / height)) >> 8;
-            for(j = 0; j < width; j++)
-                memcpy(pixdata.pixel_data+(i*pixdata.rowstride)+(j*3), rgb, 3);
+    } else {
+        for(j = 0; j < height; j++) {
+            row = pixels + j * rowstride;
+
+            for(i = 0; i < MIN(period, width); i++) {
+                gint t = gradient_dither_matrix[j & 3][i & 3];
+
+                row[i * 3] = gradient_channel(r, t, step);
+                row[i * 3 + 1] = gradient_channel(g, t, step);
+                row[i * 3 + 2] = gradient_channel(b, t, step);
+            }
+
+            gradient_fill_row(row, MIN(period, width) * 3, row_len);
+
+            r += dr;
+            g += dg;
+            b += db;
         }
     }
-    
-    pix = gdk_pixbuf_from_pixdata(&pixdata, TRUE, &err);
-    if(!pix) {
-        g_warning("%s: Unable to create color gradient: %s\n", PACKAGE,
-                err->message);
-        g_error_free(err);
-    }
-    
-    g_free(pixdata.pixel_data);
-    
+
     return pix;
 }
 
@@ -237,28 +398,77 @@ xfce_backdrop_clear_cached_image(XfceBackdrop *backdrop)
 {
     g_return_if_fail(XFCE_IS_BACKDROP(backdrop));
 
-    if(backdrop->priv->pix == NULL)
+    if(backdrop->priv->surface == NULL)
         return;
 
-    g_object_unref(backdrop->priv->pix);
-    backdrop->priv->pix = NULL;
+    xfce_backdrop_cache_release(backdrop->priv->surface);
+    backdrop->priv->surface = NULL;
 }
 
-/* we compare by the collate key so the image listing is the same as how
- * xfdesktop-settings displays the images */
-static gint
-compare_by_collate_key(const gchar *a, const gchar *b)
+static void
+xfce_backdrop_file_query_cb(GObject *source,
+                            GAsyncResult *res,
+                            gpointer user_data)
 {
-    gint ret;
-    gchar *a_key = g_utf8_collate_key_for_filename(a, -1);
-    gchar *b_key = g_utf8_collate_key_for_filename(b, -1);
+    XfceBackdropFileQuery *query = user_data;
+    XfceBackdrop *backdrop = query->backdrop;
+    GFileInfo *info;
+    gchar *dir_name = NULL, *image_dir = NULL;
 
-    ret = g_strcmp0(a_key, b_key);
+    info = g_file_query_info_finish(G_FILE(source), res, NULL);
 
-    g_free(a_key);
-    g_free(b_key);
+    /* the directory changed or cycling was turned off in the meantime */
+    if(!g_cancellable_is_cancelled(query->cancellable)
+       && info && backdrop->priv->image_files
+       && backdrop->priv->cycle_backdrop && backdrop->priv->image_path)
+    {
+        dir_name = g_path_get_dirname(query->path);
+        image_dir = g_path_get_dirname(backdrop->priv->image_path);
+
+        if(g_strcmp0(dir_name, image_dir) == 0
+           && xfdesktop_image_mime_type_is_valid(g_file_info_get_content_type(info))
+           && !xfce_backdrop_playlist_contains(backdrop->priv->image_files,
+                                               query->path))
+        {
+            xfce_backdrop_playlist_add(backdrop->priv->image_files,
+                                       query->path);
+        }
 
-    return ret;
+        g_free(dir_name);
+        g_free(image_dir);
+    }
+
+    if(info)
+        g_object_unref(info);
+    g_object_unref(query->cancellable);
+    g_free(query->path);
+    g_slice_free(XfceBackdropFileQuery, query);
+}
+
+/* Adds @file to image_files if it's an image.  The content type is looked
+ * up in the background like the directory scan does, a blocking query
+ * per new file would stall the desktop on network shares. */
+static void
+xfce_backdrop_query_new_file(XfceBackdrop *backdrop,
+                             GFile *file)
+{
+    XfceBackdropFileQuery *query;
+
+    if(!backdrop->priv->file_queries_cancellable)
+        backdrop->priv->file_queries_cancellable = g_cancellable_new();
+
+    query = g_slice_new0(XfceBackdropFileQuery);
+    query->backdrop = backdrop;
+    query->cancellable = g_object_ref(backdrop->priv->file_queries_cancellable);
+    query->path = g_file_get_path(file);
+
+    g_file_query_info_async(file,
+                            G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE,
+                            G_FILE_QUERY_INFO_NONE,
+                            G_PRIORITY_LOW,
+                            query->cancellable,
+                            xfce_backdrop_file_query_cb,
+                            query);
 }
 
 static void
@@ -270,7 +480,6 @@ cb_xfce_backdrop__image_files_changed(GFileMonitor     *monitor,
 {
     XfceBackdrop *backdrop = XFCE_BACKDROP(user_data);
     gchar *changed_file = NULL;
-    GList *item;
 
     switch(event) {
         case G_FILE_MONITOR_EVENT_CREATED:
@@ -278,39 +487,29 @@ cb_xfce_backdrop__image_files_changed(GFileMonitor     *monitor,
 
             XF_DEBUG("file added: %s", changed_file);
 
-            /* Make sure we don't already have the new file in the list */
-            if(g_list_find(backdrop->priv->image_files, changed_file)) {
-                g_free(changed_file);
-                return;
-            }
+            if(!backdrop->priv->image_files)
+                backdrop->priv->image_files = xfce_backdrop_playlist_new();
 
-            /* If the new file is not an image then we don't have to do
-             * anything */
-            if(!xfdesktop_image_file_is_valid(changed_file)) {
-                g_free(changed_file);
-                return;
+            /* If we don't have the new file in the list yet, add it once
+             * we know it is an image */
+            if(changed_file
+               && !xfce_backdrop_playlist_contains(backdrop->priv->image_files,
+                                                   changed_file))
+            {
+                xfce_backdrop_query_new_file(backdrop, file);
             }
 
-            /* It is an image file and we don't have it in our list, add it
-             * sorted to our list, don't free changed file, that will happen
-             * when it is removed */
-            backdrop->priv->image_files = g_list_insert_sorted(backdrop->priv->image_files,
-                                                               changed_file,
-                                                               (GCompareFunc)compare_by_collate_key);
+            g_free(changed_file);
             break;
         case G_FILE_MONITOR_EVENT_DELETED:
             changed_file = g_file_get_path(file);
 
             XF_DEBUG("file deleted: %s", changed_file);
 
-            /* find the file in the list */
-            item = g_list_find_custom(backdrop->priv->image_files,
-                                      changed_file,
-                                      (GCompareFunc)g_strcmp0);
-
-            /* remove it */
-            if(item)
-                backdrop->priv->image_files = g_list_delete_link(backdrop->priv->image_files, item);
+            /* remove it from the list, if it is in there */
+            if(backdrop->priv->image_files)
+                xfce_backdrop_playlist_remove(backdrop->priv->image_files,
+                                              changed_file);
 
             g_free(changed_file);
             break;
@@ -322,7 +521,9 @@ cb_xfce_backdrop__image_files_changed(GFileMonitor     *monitor,
 
             if(g_strcmp0(changed_file, backdrop->priv->image_path) == 0) {
                 DBG("match");
-                /* clear the outdated backdrop */
+                /* clear the outdated backdrop, and anything that might
+                 * still be reading the old file */
+                xfce_backdrop_cancel_generate(backdrop);
                 xfce_backdrop_clear_cached_image(backdrop);
 
                 /* backdrop changed! */
@@ -336,40 +537,172 @@ cb_xfce_backdrop__image_files_changed(GFileMonitor     *monitor,
     }
 }
 
-/* Returns a GList of all the image files in the parent directory of filename */
-static GList *
-list_image_files_in_dir(const gchar *filename)
+static void
+xfce_backdrop_scan_free(XfceBackdropScan *scan)
 {
-    GDir *dir;
-    gboolean needs_slash = TRUE;
-    const gchar *file;
-    GList *files = NULL;
-    gchar *dir_name;
+    g_object_unref(scan->cancellable);
+    g_free(scan->dir_name);
+    g_slice_free(XfceBackdropScan, scan);
+}
 
-    dir_name = g_path_get_dirname(filename);
+static void
+xfce_backdrop_cancel_scan(XfceBackdrop *backdrop)
+{
+    if(!backdrop->priv->scan)
+        return;
 
-    dir = g_dir_open(dir_name, 0, 0);
-    if(!dir) {
-        g_free(dir_name);
-        return NULL;
+    /* the pending callback frees it */
+    g_cancellable_cancel(backdrop->priv->scan->cancellable);
+    backdrop->priv->scan->backdrop = NULL;
+    backdrop->priv->scan = NULL;
+}
+
+static void
+xfce_backdrop_free_image_files(XfceBackdrop *backdrop)
+{
+    xfce_backdrop_cancel_scan(backdrop);
+    backdrop->priv->cycle_pending = FALSE;
+
+    /* the pending callbacks free their queries */
+    if(backdrop->priv->file_queries_cancellable) {
+        g_cancellable_cancel(backdrop->priv->file_queries_cancellable);
+        g_object_unref(backdrop->priv->file_queries_cancellable);
+        backdrop->priv->file_queries_cancellable = NULL;
+    }
+
+    if(backdrop->priv->image_files) {
+        xfce_backdrop_playlist_free(backdrop->priv->image_files);
+        backdrop->priv->image_files = NULL;
+    }
+}
+
+static void
+xfce_backdrop_scan_done(XfceBackdropScan *scan,
+                        GFileEnumerator *enumerator)
+{
+    XfceBackdrop *backdrop = scan->backdrop;
+
+    if(enumerator) {
+        g_file_enumerator_close_async(enumerator, G_PRIORITY_LOW,
+                                      NULL, NULL, NULL);
+        g_object_unref(enumerator);
+    }
+
+    xfce_backdrop_scan_free(scan);
+
+    if(!backdrop)
+        return;
+
+    XF_DEBUG("found %u images",
+             xfce_backdrop_playlist_get_length(backdrop->priv->image_files));
+
+    backdrop->priv->scan = NULL;
+
+    /* now that we know all the images, do what had to wait for that */
+    if(backdrop->priv->cycle_pending) {
+        backdrop->priv->cycle_pending = FALSE;
+        xfce_backdrop_cycle_backdrop(backdrop);
+    }
+
+    if(!backdrop->priv->prefetch_data)
+        xfce_backdrop_prefetch_next(backdrop);
+}
+
+static void
+xfce_backdrop_scan_next_files_cb(GObject *source,
+                                 GAsyncResult *res,
+                                 gpointer user_data)
+{
+    XfceBackdropScan *scan = user_data;
+    GFileEnumerator *enumerator = G_FILE_ENUMERATOR(source);
+    GList *files, *l;
+    GPtrArray *paths;
+
+    files = g_file_enumerator_next_files_finish(enumerator, res, NULL);
+
+    /* canceled, at the end or failed */
+    if(!scan->backdrop || !files) {
+        g_list_free_full(files, g_object_unref);
+        xfce_backdrop_scan_done(scan, enumerator);
+        return;
+    }
+
+    paths = g_ptr_array_new_with_free_func(g_free);
+
+    for(l = files; l != NULL; l = l->next) {
+        GFileInfo *info = l->data;
+
+        if(xfdesktop_image_mime_type_is_valid(g_file_info_get_content_type(info))) {
+            g_ptr_array_add(paths, g_build_filename(scan->dir_name,
+                                                    g_file_info_get_name(info),
+                                                    NULL));
+        }
     }
 
-    if(dir_name[strlen(dir_name)-1] == '/')
-        needs_slash = FALSE;
+    /* publish what we have so far, cycling can go ahead with it */
+    xfce_backdrop_playlist_add_many(scan->backdrop->priv->image_files,
+                                    (gchar **)paths->pdata, paths->len);
+
+    g_ptr_array_free(paths, TRUE);
+    g_list_free_full(files, g_object_unref);
+
+    g_file_enumerator_next_files_async(enumerator,
+                                       XFCE_BACKDROP_SCAN_BATCH_SIZE,
+                                       G_PRIORITY_LOW,
+                                       scan->cancellable,
+                                       xfce_backdrop_scan_next_files_cb,
+                                       scan);
+}
+
+static void
+xfce_backdrop_scan_enumerate_cb(GObject *source,
+                                GAsyncResult *res,
+                                gpointer user_data)
+{
+    XfceBackdropScan *scan = user_data;
+    GFileEnumerator *enumerator;
+
+    enumerator = g_file_enumerate_children_finish(G_FILE(source), res, NULL);
 
-    while((file = g_dir_read_name(dir))) {
-        gchar *current_file = g_strdup_printf(needs_slash ? "%s/%s" : "%s%s",
-                                              dir_name, file);
-        if(xfdesktop_image_file_is_valid(current_file))
-            files = g_list_insert_sorted(files, current_file, (GCompareFunc)compare_by_collate_key);
-        else
-            g_free(current_file);
+    if(!scan->backdrop || !enumerator) {
+        xfce_backdrop_scan_done(scan, enumerator);
+        return;
     }
 
-    g_dir_close(dir);
-    g_free(dir_name);
+    g_file_enumerator_next_files_async(enumerator,
+                                       XFCE_BACKDROP_SCAN_BATCH_SIZE,
+                                       G_PRIORITY_LOW,
+                                       scan->cancellable,
+                                       xfce_backdrop_scan_next_files_cb,
+                                       scan);
+}
 
-    return files;
+/* Starts filling image_files with all the image files in the parent
+ * directory of image_path.  The directory is read in the background and
+ * the content type of each file comes with the listing, so this never
+ * blocks, which matters for wallpapers on network shares. */
+static void
+xfce_backdrop_scan_image_files(XfceBackdrop *backdrop,
+                               GFile *dir)
+{
+    XfceBackdropScan *scan;
+
+    xfce_backdrop_cancel_scan(backdrop);
+
+    scan = g_slice_new0(XfceBackdropScan);
+    scan->backdrop = backdrop;
+    scan->cancellable = g_cancellable_new();
+    scan->dir_name = g_file_get_path(dir);
+    backdrop->priv->scan = scan;
+
+    g_file_enumerate_children_async(dir,
+                                    G_FILE_ATTRIBUTE_STANDARD_NAME ","
+                                    G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE,
+                                    G_FILE_QUERY_INFO_NONE,
+                                    G_PRIORITY_LOW,
+                                    scan->cancellable,
+                                    xfce_backdrop_scan_enumerate_cb,
+                                    scan);
 }
 
 static void
@@ -383,7 +716,8 @@ xfce_backdrop_load_image_files(XfceBackdrop *backdrop)
         gchar *dir_name = g_path_get_dirname(backdrop->priv->image_path);
         GFile *gfile = g_file_new_for_path(dir_name);
 
-        backdrop->priv->image_files = list_image_files_in_dir(backdrop->priv->image_path);
+        backdrop->priv->image_files = xfce_backdrop_playlist_new();
+        xfce_backdrop_scan_image_files(backdrop, gfile);
 
         if(backdrop->priv->monitor) {
             g_signal_handlers_disconnect_by_func(G_OBJECT(backdrop->priv->monitor),
@@ -409,35 +743,83 @@ xfce_backdrop_load_image_files(XfceBackdrop *backdrop)
 gchar *
 xfce_backdrop_choose_next(XfceBackdrop *backdrop)
 {
-    GList *current_file;
-    const gchar *filename;
+    gint n_items, current_file;
 
     TRACE("entering");
 
     g_return_val_if_fail(XFCE_IS_BACKDROP(backdrop), NULL);
 
-    filename = backdrop->priv->image_path;
-
     if(!backdrop->priv->image_files)
         return NULL;
 
+    n_items = xfce_backdrop_playlist_get_length(backdrop->priv->image_files);
+    if(n_items == 0)
+        return NULL;
+
     /* Get the our current background in the list */
-    current_file = g_list_find_custom(backdrop->priv->image_files, filename, (GCompareFunc)g_strcmp0);
+    current_file = xfce_backdrop_playlist_index_of(backdrop->priv->image_files,
+                                                   backdrop->priv->image_path);
 
-    /* if somehow we don't have a valid file, grab the first one available */
-    if(current_file == NULL) {
-        current_file = g_list_first(backdrop->priv->image_files);
-    } else {
-        /* We want the next valid image file in the dir */
-        current_file = g_list_next(current_file);
+    /* We want the next valid image file in the dir, if somehow we don't
+     * have a valid file this grabs the first one available, and if we hit
+     * the end of the list we wrap around to the front */
+    current_file = (current_file + 1) % n_items;
+
+    /* return a copy of our new item */
+    return g_strdup(xfce_backdrop_playlist_get_nth(backdrop->priv->image_files,
+                                                   current_file));
+}
+
+/* Recreates the shuffled order of image_files from shuffle_seed with a
+ * Fisher-Yates shuffle, so the same seed and images give the same order */
+static void
+xfce_backdrop_shuffle_bag_fill(XfceBackdrop *backdrop,
+                               guint n_items)
+{
+    GRand *rand;
+    guint *bag;
+    guint i, j, tmp;
+
+    bag = g_renew(guint, backdrop->priv->shuffle_bag, n_items);
 
-        /* we hit the end of the list, wrap around to the front */
-        if(current_file == NULL)
-            current_file = g_list_first(backdrop->priv->image_files);
+    for(i = 0; i < n_items; i++)
+        bag[i] = i;
+
+    rand = g_rand_new_with_seed(backdrop->priv->shuffle_seed);
+    for(i = n_items - 1; i > 0; i--) {
+        j = g_rand_int_range(rand, 0, i + 1);
+        tmp = bag[i];
+        bag[i] = bag[j];
+        bag[j] = tmp;
     }
+    g_rand_free(rand);
 
-    /* return a copy of our new item */
-    return g_strdup(current_file->data);
+    backdrop->priv->shuffle_bag = bag;
+    backdrop->priv->shuffle_bag_len = n_items;
+}
+
+static void
+xfce_backdrop_shuffle_bag_clear(XfceBackdrop *backdrop)
+{
+    g_free(backdrop->priv->shuffle_bag);
+    backdrop->priv->shuffle_bag = NULL;
+    backdrop->priv->shuffle_bag_len = 0;
+}
+
+/* Starts over with a new order */
+static void
+xfce_backdrop_shuffle_bag_reset(XfceBackdrop *backdrop,
+                                guint n_items)
+{
+    /* 0 means we never had a seed */
+    do {
+        backdrop->priv->shuffle_seed = g_random_int();
+    } while(backdrop->priv->shuffle_seed == 0);
+    backdrop->priv->shuffle_position = 0;
+
+    xfce_backdrop_shuffle_bag_fill(backdrop, n_items);
+
+    g_object_notify(G_OBJECT(backdrop), "backdrop-cycle-shuffle-seed");
 }
 
 /* Gets a random valid image file in the folder. Free when done using it.
@@ -445,32 +827,50 @@ xfce_backdrop_choose_next(XfceBackdrop *backdrop)
 gchar *
 xfce_backdrop_choose_random(XfceBackdrop *backdrop)
 {
-    static gint previndex = -1;
-    gint n_items = 0, cur_file;
+    XfceBackdropPlaylist *image_files;
+    const gchar *new_file;
+    guint n_items;
 
     TRACE("entering");
 
     g_return_val_if_fail(XFCE_IS_BACKDROP(backdrop), NULL);
 
-    if(!backdrop->priv->image_files)
+    image_files = backdrop->priv->image_files;
+    if(!image_files)
         return NULL;
 
-    n_items = g_list_length(backdrop->priv->image_files);
+    n_items = xfce_backdrop_playlist_get_length(image_files);
+    if(n_items == 0)
+        return NULL;
 
     /* If there's only 1 item, just return it, easy */
     if(1 == n_items) {
-        return g_strdup(g_list_first(backdrop->priv->image_files)->data);
+        return g_strdup(xfce_backdrop_playlist_get_nth(image_files, 0));
     }
 
+    /* The order depends on the number of images, so it changes when images
+     * are added or removed.  We keep going from the same position then,
+     * which may repeat an image or two but doesn't start all over. */
+    if(backdrop->priv->shuffle_seed == 0)
+        xfce_backdrop_shuffle_bag_reset(backdrop, n_items);
+    else if(backdrop->priv->shuffle_bag_len != n_items)
+        xfce_backdrop_shuffle_bag_fill(backdrop, n_items);
+
+    /* Don't pick what we're showing right now, that happens when a new
+     * order starts with the image the previous one ended with */
     do {
-        /* g_random_int_range bounds to n_items-1 */
-        cur_file = g_random_int_range(0, n_items);
-    } while(cur_file == previndex && G_LIKELY(previndex != -1));
+        if(backdrop->priv->shuffle_position >= n_items)
+            xfce_backdrop_shuffle_bag_reset(backdrop, n_items);
+
+        new_file = xfce_backdrop_playlist_get_nth(image_files,
+                                                  backdrop->priv->shuffle_bag[backdrop->priv->shuffle_position]);
+        backdrop->priv->shuffle_position++;
+    } while(g_strcmp0(new_file, backdrop->priv->image_path) == 0);
 
-    previndex = cur_file;
+    g_object_notify(G_OBJECT(backdrop), "backdrop-cycle-shuffle-position");
 
     /* return a copy of the new random item */
-    return g_strdup(g_list_nth(backdrop->priv->image_files, cur_file)->data);
+    return g_strdup(new_file);
 }
 
 /* Provides a mapping of image files in the parent folder of file. It selects
@@ -481,7 +881,7 @@ gchar *
 xfce_backdrop_choose_chronological(XfceBackdrop *backdrop)
 {
     GDateTime *datetime;
-    GList *new_file;
+    const gchar *new_file;
     gint n_items = 0, epoch;
 
     TRACE("entering");
@@ -491,11 +891,13 @@ xfce_backdrop_choose_chronological(XfceBackdrop *backdrop)
     if(!backdrop->priv->image_files)
         return NULL;
 
-    n_items = g_list_length(backdrop->priv->image_files);
+    n_items = xfce_backdrop_playlist_get_length(backdrop->priv->image_files);
+    if(n_items == 0)
+        return NULL;
 
     /* If there's only 1 item, just return it, easy */
     if(1 == n_items) {
-        return g_strdup(g_list_first(backdrop->priv->image_files)->data);
+        return g_strdup(xfce_backdrop_playlist_get_nth(backdrop->priv->image_files, 0));
     }
 
     datetime = g_date_time_new_now_local();
@@ -505,12 +907,12 @@ xfce_backdrop_choose_chronological(XfceBackdrop *backdrop)
     epoch = (gdouble)g_date_time_get_hour(datetime) / (24.0f / MIN(n_items, 24.0f));
     XF_DEBUG("epoch %d, hour %d, items %d", epoch, g_date_time_get_hour(datetime), n_items);
 
-    new_file = g_list_nth(backdrop->priv->image_files, epoch);
+    new_file = xfce_backdrop_playlist_get_nth(backdrop->priv->image_files, epoch);
 
     g_date_time_unref(datetime);
 
     /* return a copy of our new file */
-    return g_strdup(new_file->data);
+    return g_strdup(new_file);
 }
 
 /* gobject-related functions */
@@ -621,6 +1023,21 @@ xfce_backdrop_class_init(XfceBackdropClass *klass)
                                                          FALSE,
                                                          XFDESKTOP_PARAM_FLAGS));
 
+    /* where random order is at, so it carries on after a restart */
+    g_object_class_install_property(gobject_class, PROP_BACKDROP_SHUFFLE_SEED,
+                                    g_param_spec_uint("backdrop-cycle-shuffle-seed",
+                                                      "backdrop-cycle-shuffle-seed",
+                                                      "backdrop-cycle-shuffle-seed",
+                                                      0, G_MAXUINT, 0,
+                                                      XFDESKTOP_PARAM_FLAGS));
+
+    g_object_class_install_property(gobject_class, PROP_BACKDROP_SHUFFLE_POSITION,
+                                    g_param_spec_uint("backdrop-cycle-shuffle-position",
+                                                      "backdrop-cycle-shuffle-position",
+                                                      "backdrop-cycle-shuffle-position",
+                                                      0, G_MAXUINT, 0,
+                                                      XFDESKTOP_PARAM_FLAGS));
+
 #undef XFDESKTOP_PARAM_FLAGS
 }
 
@@ -655,7 +1072,11 @@ xfce_backdrop_finalize(GObject *object)
         backdrop->priv->cycle_timer_id = 0;
     }
 
+    xfce_backdrop_cancel_generate(backdrop);
+    xfce_backdrop_cancel_prefetch(backdrop);
+
     xfce_backdrop_clear_cached_image(backdrop);
+    xfce_backdrop_release_previous_surface(backdrop);
 
     if(backdrop->priv->monitor) {
         g_signal_handlers_disconnect_by_func(G_OBJECT(backdrop->priv->monitor),
@@ -667,10 +1088,8 @@ xfce_backdrop_finalize(GObject *object)
     }
 
     /* Free the image files list */
-    if(backdrop->priv->image_files) {
-        g_list_free_full(backdrop->priv->image_files, g_free);
-        backdrop->priv->image_files = NULL;
-    }
+    xfce_backdrop_free_image_files(backdrop);
+    xfce_backdrop_shuffle_bag_clear(backdrop);
 
     G_OBJECT_CLASS(xfce_backdrop_parent_class)->finalize(object);
 }
@@ -726,6 +1145,17 @@ xfce_backdrop_set_property(GObject *object,
             xfce_backdrop_set_random_order(backdrop, g_value_get_boolean(value));
             break;
 
+        case PROP_BACKDROP_SHUFFLE_SEED:
+            if(backdrop->priv->shuffle_seed != g_value_get_uint(value)) {
+                backdrop->priv->shuffle_seed = g_value_get_uint(value);
+                xfce_backdrop_shuffle_bag_clear(backdrop);
+            }
+            break;
+
+        case PROP_BACKDROP_SHUFFLE_POSITION:
+            backdrop->priv->shuffle_position = g_value_get_uint(value);
+            break;
+
         default:
             G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
             break;
@@ -778,6 +1208,14 @@ xfce_backdrop_get_property(GObject *object,
             g_value_set_boolean(value, xfce_backdrop_get_random_order(backdrop));
             break;
 
+        case PROP_BACKDROP_SHUFFLE_SEED:
+            g_value_set_uint(value, backdrop->priv->shuffle_seed);
+            break;
+
+        case PROP_BACKDROP_SHUFFLE_POSITION:
+            g_value_set_uint(value, backdrop->priv->shuffle_position);
+            break;
+
         default:
             G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
             break;
@@ -1009,6 +1447,7 @@ void
 xfce_backdrop_set_image_filename(XfceBackdrop *backdrop, const gchar *filename)
 {
     gchar *old_dir = NULL, *new_dir = NULL;
+    gboolean prefetched;
     g_return_if_fail(XFCE_IS_BACKDROP(backdrop));
 
     TRACE("entering, filename %s", filename);
@@ -1026,8 +1465,7 @@ xfce_backdrop_set_image_filename(XfceBackdrop *backdrop, const gchar *filename)
 
         /* Directories did change, free list */
         if(g_strcmp0(old_dir, new_dir) != 0) {
-            g_list_free_full(backdrop->priv->image_files, g_free);
-            backdrop->priv->image_files = NULL;
+            xfce_backdrop_free_image_files(backdrop);
 
             /* release the directory monitor */
             if(backdrop->priv->monitor) {
@@ -1056,7 +1494,16 @@ xfce_backdrop_set_image_filename(XfceBackdrop *backdrop, const gchar *filename)
 
     xfce_backdrop_load_image_files(backdrop);
 
+    /* if this is the image we rendered ahead of time, it's ready to be
+     * shown right away */
+    prefetched = xfce_backdrop_use_prefetch(backdrop);
+
     g_signal_emit(G_OBJECT(backdrop), backdrop_signals[BACKDROP_CHANGED], 0);
+
+    /* there won't be a "ready" signal in that case, so get the next one
+     * going from here */
+    if(prefetched)
+        xfce_backdrop_prefetch_next(backdrop);
 }
 
 const gchar *
@@ -1082,19 +1529,45 @@ xfce_backdrop_cycle_backdrop(XfceBackdrop *backdrop)
     if(backdrop->priv->image_path == NULL || !backdrop->priv->cycle_backdrop)
         return;
 
+    /* The directory is still being read.  Picking by the time of day needs
+     * to know all the images, and so does the one time pick at startup to
+     * be fair; otherwise go ahead as soon as there is something to pick. */
+    if(backdrop->priv->scan != NULL
+       && (period == XFCE_BACKDROP_PERIOD_CHRONOLOGICAL
+           || period == XFCE_BACKDROP_PERIOD_STARTUP
+           || xfce_backdrop_playlist_get_length(backdrop->priv->image_files) == 0))
+    {
+        backdrop->priv->cycle_pending = TRUE;
+        return;
+    }
+
     if(period == XFCE_BACKDROP_PERIOD_CHRONOLOGICAL) {
         /* chronological first */
         new_backdrop = xfce_backdrop_choose_chronological(backdrop);
     } else if(backdrop->priv->random_backdrop_order) {
-        /* then random */
-        new_backdrop = xfce_backdrop_choose_random(backdrop);
+        /* then random, we may have picked and rendered it ahead of time
+         * already */
+        if(backdrop->priv->prefetch_data != NULL
+           && backdrop->priv->image_files != NULL
+           && xfce_backdrop_playlist_contains(backdrop->priv->image_files,
+                                              backdrop->priv->prefetch_data->image_path))
+        {
+            new_backdrop = g_strdup(backdrop->priv->prefetch_data->image_path);
+        } else
+            new_backdrop = xfce_backdrop_choose_random(backdrop);
     } else {
-        /* sequential, the default */
+        /* sequential, the default.  If more images showed up since the
+         * next one was prefetched, this may not be the prefetched one */
         new_backdrop = xfce_backdrop_choose_next(backdrop);
     }
 
     /* Only emit the cycle signal if something changed */
     if(g_strcmp0(backdrop->priv->image_path, new_backdrop) != 0) {
+        /* hang on to the old image so the desktop can fade from it */
+        xfce_backdrop_release_previous_surface(backdrop);
+        backdrop->priv->previous_surface = backdrop->priv->surface;
+        backdrop->priv->surface = NULL;
+
         xfce_backdrop_set_image_filename(backdrop, new_backdrop);
         g_signal_emit(G_OBJECT(backdrop), backdrop_signals[BACKDROP_CYCLE], 0);
     }
@@ -1299,10 +1772,12 @@ xfce_backdrop_set_cycle_backdrop(XfceBackdrop *backdrop,
     }
 
     /* If we're not cycling anymore, free the image files list */
-    if(!backdrop->priv->cycle_backdrop && backdrop->priv->image_files) {
-        g_list_free_full(backdrop->priv->image_files, g_free);
-        backdrop->priv->image_files = NULL;
-    }
+    if(!backdrop->priv->cycle_backdrop)
+        xfce_backdrop_free_image_files(backdrop);
+
+    /* nor do we need the next image anymore */
+    if(!backdrop->priv->cycle_backdrop)
+        xfce_backdrop_cancel_prefetch(backdrop);
 }
 
 gboolean
@@ -1393,30 +1868,31 @@ xfce_backdrop_force_cycle(XfceBackdrop *backdrop)
 /* Generates the background that will either be displayed or will have the
  * image drawn on top of */
 static GdkPixbuf *
-xfce_backdrop_generate_canvas(XfceBackdrop *backdrop)
+xfce_backdrop_generate_canvas(XfceBackdropImageData *image_data)
 {
     gint w, h;
     GdkPixbuf *final_image;
 
-    w = backdrop->priv->width;
-    h = backdrop->priv->height;
+    w = image_data->width;
+    h = image_data->height;
 
     /* In case we somehow end up here, give a warning and apply a temp fix */
-    if(backdrop->priv->color_style == XFCE_BACKDROP_COLOR_INVALID) {
+    if(image_data->color_style == XFCE_BACKDROP_COLOR_INVALID) {
         g_warning("xfce_backdrop_generate_canvas: Invalid color style");
-        backdrop->priv->color_style = XFCE_BACKDROP_COLOR_SOLID;
+        image_data->color_style = XFCE_BACKDROP_COLOR_SOLID;
     }
 
-    if(backdrop->priv->color_style == XFCE_BACKDROP_COLOR_SOLID)
-        final_image = create_solid(&backdrop->priv->color1, w, h, FALSE, 0xff);
-    else if(backdrop->priv->color_style == XFCE_BACKDROP_COLOR_TRANSPARENT) {
+    if(image_data->color_style == XFCE_BACKDROP_COLOR_SOLID)
+        final_image = create_solid(&image_data->color1, w, h, FALSE, 0xff);
+    else if(image_data->color_style == XFCE_BACKDROP_COLOR_TRANSPARENT) {
         GdkColor c = { 0, 0xffff, 0xffff, 0xffff };
         final_image = create_solid(&c, w, h, TRUE, 0x00);
     } else {
-        final_image = create_gradient(&backdrop->priv->color1,
-                &backdrop->priv->color2, w, h, backdrop->priv->color_style);
+        final_image = create_gradient(&image_data->color1,
+                &image_data->color2, w, h, image_data->color_style,
+                image_data->bpp);
         if(!final_image)
-            final_image = create_solid(&backdrop->priv->color1, w, h, FALSE, 0xff);
+            final_image = create_solid(&image_data->color1, w, h, FALSE, 0xff);
     }
 
     return final_image;
@@ -1431,38 +1907,269 @@ xfce_backdrop_image_data_release(XfceBackdropImageData *image_data)
         return;
 
     /* Only set the backdrop's image_data to NULL if it's current */
-    if(image_data->backdrop->priv->image_data == image_data)
+    if(image_data->backdrop
+       && image_data->backdrop->priv->image_data == image_data)
+    {
         image_data->backdrop->priv->image_data = NULL;
+    }
+    if(image_data->backdrop
+       && image_data->backdrop->priv->prefetch_data == image_data)
+    {
+        image_data->backdrop->priv->prefetch_data = NULL;
+    }
 
     if(image_data->cancellable)
         g_object_unref(image_data->cancellable);
 
-    if(image_data->image_buffer)
-        g_free(image_data->image_buffer);
+    if(image_data->surface)
+        xfce_backdrop_cache_release(image_data->surface);
 
-    if(image_data->loader)
-        g_object_unref(image_data->loader);
+    g_free(image_data->image_path);
+    g_free(image_data);
+}
+
+/* Cancels the pending generate request, if any.  The worker thread may still
+ * be busy with it, so the request is only detached from the backdrop here;
+ * xfce_backdrop_generate_done() frees it once the worker is done. */
+static void
+xfce_backdrop_cancel_generate(XfceBackdrop *backdrop)
+{
+    XfceBackdropImageData *image_data = backdrop->priv->image_data;
+
+    if(!image_data)
+        return;
+
+    g_cancellable_cancel(image_data->cancellable);
+    image_data->backdrop = NULL;
+    backdrop->priv->image_data = NULL;
+}
+
+/* Returns the image a generate request for @backdrop would load right now */
+static const gchar *
+xfce_backdrop_get_effective_image_path(XfceBackdrop *backdrop)
+{
+    if(backdrop->priv->image_style == XFCE_BACKDROP_IMAGE_NONE)
+        return NULL;
+
+    /* If we're trying to display an image, attempt to use the one the user
+     * set. If there's none set at all, fall back to our default. */
+    if(backdrop->priv->image_path != NULL)
+        return backdrop->priv->image_path;
+
+    return DEFAULT_BACKDROP;
+}
+
+/* Takes a snapshot of the backdrop's settings for the worker thread */
+static XfceBackdropImageData *
+xfce_backdrop_image_data_new(XfceBackdrop *backdrop,
+                             const gchar *image_path)
+{
+    XfceBackdropImageData *image_data = g_new0(XfceBackdropImageData, 1);
+
+    image_data->backdrop = backdrop;
+    image_data->cancellable = g_cancellable_new();
+    image_data->image_path = g_strdup(image_path);
+    image_data->width = backdrop->priv->width;
+    image_data->height = backdrop->priv->height;
+    image_data->bpp = backdrop->priv->bpp;
+    image_data->color_style = backdrop->priv->color_style;
+    image_data->color1 = backdrop->priv->color1;
+    image_data->color2 = backdrop->priv->color2;
+    image_data->image_style = backdrop->priv->image_style;
+
+    return image_data;
+}
+
+/* Whether @image_data produces what @backdrop should show right now */
+static gboolean
+xfce_backdrop_image_data_is_current(XfceBackdropImageData *image_data,
+                                    XfceBackdrop *backdrop)
+{
+    return image_data->width == backdrop->priv->width
+           && image_data->height == backdrop->priv->height
+           && image_data->bpp == backdrop->priv->bpp
+           && image_data->color_style == backdrop->priv->color_style
+           && gdk_color_equal(&image_data->color1, &backdrop->priv->color1)
+           && gdk_color_equal(&image_data->color2, &backdrop->priv->color2)
+           && image_data->image_style == backdrop->priv->image_style
+           && g_strcmp0(image_data->image_path,
+                        xfce_backdrop_get_effective_image_path(backdrop)) == 0;
+}
+
+static void
+xfce_backdrop_queue_generate(XfceBackdropImageData *image_data)
+{
+    if(G_UNLIKELY(backdrop_thread_pool == NULL)) {
+        backdrop_thread_pool = g_thread_pool_new(xfce_backdrop_generate_thread,
+                                                 NULL,
+                                                 XFCE_BACKDROP_MAX_THREADS,
+                                                 FALSE,
+                                                 NULL);
+    }
+
+    g_thread_pool_push(backdrop_thread_pool, image_data, NULL);
+}
+
+/* Drops the prefetched image, or the request for it if it is still being
+ * rendered. */
+static void
+xfce_backdrop_cancel_prefetch(XfceBackdrop *backdrop)
+{
+    XfceBackdropImageData *image_data = backdrop->priv->prefetch_data;
+
+    if(!image_data)
+        return;
+
+    backdrop->priv->prefetch_data = NULL;
+    image_data->backdrop = NULL;
+
+    if(image_data->finished)
+        xfce_backdrop_image_data_release(image_data);
+    else
+        g_cancellable_cancel(image_data->cancellable);
+}
+
+/* Called once the backdrop switched images.  If the prefetched image is
+ * the one we need, it becomes the backdrop's image without any further
+ * work; if it is still being rendered, it becomes the pending generate
+ * request instead.  Any other prefetched image is stale and dropped.
+ * Returns TRUE if the backdrop has its image right away. */
+static gboolean
+xfce_backdrop_use_prefetch(XfceBackdrop *backdrop)
+{
+    XfceBackdropImageData *image_data = backdrop->priv->prefetch_data;
+
+    if(!image_data)
+        return FALSE;
+
+    if(!xfce_backdrop_image_data_is_current(image_data, backdrop)) {
+        xfce_backdrop_cancel_prefetch(backdrop);
+        return FALSE;
+    }
+
+    backdrop->priv->prefetch_data = NULL;
+
+    if(!image_data->finished) {
+        xfce_backdrop_cancel_generate(backdrop);
+        image_data->prefetch = FALSE;
+        backdrop->priv->image_data = image_data;
+        return FALSE;
+    }
+
+    XF_DEBUG("using prefetched %s", image_data->image_path);
+
+    xfce_backdrop_clear_cached_image(backdrop);
+    backdrop->priv->surface = image_data->surface;
+    image_data->surface = NULL;
+
+    image_data->backdrop = NULL;
+    xfce_backdrop_image_data_release(image_data);
+
+    return TRUE;
+}
+
+/* When cycling, picks the image the next cycle switches to and renders it
+ * in the background, so that the switch itself costs nothing.  Cycling by
+ * the time of day picks the image when the timer fires, so it isn't
+ * prefetched. */
+static void
+xfce_backdrop_prefetch_next(XfceBackdrop *backdrop)
+{
+    XfceBackdropImageData *image_data;
+    gchar *next;
+
+    if(!backdrop->priv->cycle_backdrop
+       || backdrop->priv->cycle_timer == 0
+       || backdrop->priv->cycle_period == XFCE_BACKDROP_PERIOD_STARTUP
+       || backdrop->priv->cycle_period == XFCE_BACKDROP_PERIOD_CHRONOLOGICAL
+       || backdrop->priv->image_style == XFCE_BACKDROP_IMAGE_NONE
+       || backdrop->priv->image_path == NULL
+       || backdrop->priv->width == 0 || backdrop->priv->height == 0
+       || backdrop->priv->scan != NULL)
+    {
+        return;
+    }
+
+    if(backdrop->priv->random_backdrop_order)
+        next = xfce_backdrop_choose_random(backdrop);
+    else
+        next = xfce_backdrop_choose_next(backdrop);
+
+    if(next == NULL || g_strcmp0(next, backdrop->priv->image_path) == 0) {
+        g_free(next);
+        return;
+    }
+
+    xfce_backdrop_cancel_prefetch(backdrop);
+
+    XF_DEBUG("prefetching %s", next);
+
+    image_data = xfce_backdrop_image_data_new(backdrop, next);
+    image_data->prefetch = TRUE;
+    backdrop->priv->prefetch_data = image_data;
+
+    xfce_backdrop_queue_generate(image_data);
+
+    g_free(next);
+}
+
+static void
+xfce_backdrop_release_previous_surface(XfceBackdrop *backdrop)
+{
+    if(backdrop->priv->previous_surface == NULL)
+        return;
+
+    xfce_backdrop_cache_release(backdrop->priv->previous_surface);
+    backdrop->priv->previous_surface = NULL;
+}
+
+/**
+ * xfce_backdrop_take_previous_surface:
+ * @backdrop: An #XfceBackdrop.
+ *
+ * Returns the image that was shown before the backdrop last cycled, so it
+ * can be faded out, and forgets about it.  Free with
+ * cairo_surface_destroy() when you are finished.
+ *
+ * Return value: The previous surface or %NULL.
+ **/
+cairo_surface_t *
+xfce_backdrop_take_previous_surface(XfceBackdrop *backdrop)
+{
+    cairo_surface_t *surface;
+
+    g_return_val_if_fail(XFCE_IS_BACKDROP(backdrop), NULL);
+
+    if(backdrop->priv->previous_surface == NULL)
+        return NULL;
+
+    surface = cairo_surface_reference(backdrop->priv->previous_surface);
+    xfce_backdrop_release_previous_surface(backdrop);
+
+    return surface;
 }
 
 /**
- * xfce_backdrop_get_pixbuf:
+ * xfce_backdrop_get_surface:
  * @backdrop: An #XfceBackdrop.
  *
  * Returns the composited backdrop image if one has been generated. If it
- * returns NULL, call xfce_backdrop_generate_async to create the pixbuf.
- * Free with g_object_unref() when you are finished.
+ * returns NULL, call xfce_backdrop_generate_async to create the surface.
+ * The surface is a cairo image surface in the native RGB24 or ARGB32
+ * format, so it can be painted onto an X pixmap as is.  Free with
+ * cairo_surface_destroy() when you are finished.
  **/
-GdkPixbuf *
-xfce_backdrop_get_pixbuf(XfceBackdrop *backdrop)
+cairo_surface_t *
+xfce_backdrop_get_surface(XfceBackdrop *backdrop)
 {
     TRACE("entering");
 
-    if(backdrop->priv->pix) {
+    if(backdrop->priv->surface) {
         /* return a reference so we can cache it */
-        return g_object_ref(backdrop->priv->pix);
+        return cairo_surface_reference(backdrop->priv->surface);
     }
 
-    /* !backdrop->priv->pix, call xfce_backdrop_generate_async */
+    /* !backdrop->priv->surface, call xfce_backdrop_generate_async */
     return NULL;
 }
 
@@ -1471,14 +2178,14 @@ xfce_backdrop_get_pixbuf(XfceBackdrop *backdrop)
  * @backdrop: An #XfceBackdrop.
  *
  * Generates the final composited, resized image from the #XfceBackdrop.
- * Emits the "ready" signal when the image has been created.
+ * The image is loaded, scaled and composited in a worker thread, only the
+ * finished image is handed back to the main loop.  Emits the "ready" signal
+ * when the image has been created.
  **/
 void
 xfce_backdrop_generate_async(XfceBackdrop *backdrop)
 {
-    GFile *file;
     XfceBackdropImageData *image_data = NULL;
-    const gchar *image_path;
 
     TRACE("entering");
 
@@ -1487,48 +2194,75 @@ xfce_backdrop_generate_async(XfceBackdrop *backdrop)
         return;
     }
 
-    if(backdrop->priv->image_data && backdrop->priv->image_data->cancellable) {
-        g_cancellable_cancel(backdrop->priv->image_data->cancellable);
-        backdrop->priv->image_data = NULL;
-    }
-
-    /* If we aren't going to display an image then just create the canvas */
-    if(backdrop->priv->image_style == XFCE_BACKDROP_IMAGE_NONE) {
-        backdrop->priv->pix = xfce_backdrop_generate_canvas(backdrop);
-        g_signal_emit(G_OBJECT(backdrop), backdrop_signals[BACKDROP_READY], 0);
+    /* the request in flight already covers this */
+    if(backdrop->priv->image_data != NULL
+       && xfce_backdrop_image_data_is_current(backdrop->priv->image_data, backdrop))
+    {
         return;
     }
 
-    /* If we're trying to display an image, attempt to use the one the user
-     * set. If there's none set at all, fall back to our default */
-    if(backdrop->priv->image_path != NULL)
-        image_path = backdrop->priv->image_path;
-    else
-        image_path = DEFAULT_BACKDROP;
+    /* a newer request supersedes whatever is still in flight */
+    xfce_backdrop_cancel_generate(backdrop);
 
-    XF_DEBUG("loading image %s", image_path);
+    /* If we aren't going to display an image the worker just creates the
+     * canvas */
+    image_data = xfce_backdrop_image_data_new(backdrop,
+                                              xfce_backdrop_get_effective_image_path(backdrop));
+    backdrop->priv->image_data = image_data;
 
-    file = g_file_new_for_path(image_path);
+    if(image_data->image_path)
+        XF_DEBUG("loading image %s", image_data->image_path);
 
-    image_data = g_new0(XfceBackdropImageData, 1);
-    backdrop->priv->image_data = image_data;
+    xfce_backdrop_queue_generate(image_data);
+}
 
-    image_data->backdrop = backdrop;
-    image_data->loader = gdk_pixbuf_loader_new();
-    image_data->cancellable = g_cancellable_new();
-    image_data->image_buffer = g_new0(guchar, XFCE_BACKDROP_BUFFER_SIZE);
 
-    g_signal_connect(image_data->loader, "size-prepared", G_CALLBACK(xfce_backdrop_loader_size_prepared_cb), image_data);
-    g_signal_connect(image_data->loader, "closed", G_CALLBACK(xfce_backdrop_loader_closed_cb), image_data);
+/* Runs in the worker thread.  Asks the loader to scale the image down to
+ * @target_width x @target_height while decoding.  JPEG can be decoded
+ * straight at 1/2, 1/4 or 1/8 of its size by skipping DCT coefficients,
+ * which is what gdk-pixbuf does internally when asked for a smaller size.
+ * For JPEG we ask for exactly the smallest such size that still covers the
+ * target, so the loader doesn't run a second full-image scale pass; the
+ * remaining scaling is then done while compositing. */
+static void
+xfce_backdrop_loader_set_size(GdkPixbufLoader *loader,
+                              XfceBackdropImageData *image_data,
+                              gint width,
+                              gint height,
+                              gint target_width,
+                              gint target_height)
+{
+    GdkPixbufFormat *format;
+    gchar *format_name = NULL;
+    gint denom;
+
+    format = gdk_pixbuf_loader_get_format(loader);
+    if(format)
+        format_name = gdk_pixbuf_format_get_name(format);
+
+    if(g_strcmp0(format_name, "jpeg") == 0) {
+        for(denom = 8; denom > 1; denom /= 2) {
+            /* libjpeg rounds the scaled size up */
+            gint dct_width = (width + denom - 1) / denom;
+            gint dct_height = (height + denom - 1) / denom;
+
+            if(dct_width >= target_width && dct_height >= target_height) {
+                XF_DEBUG("decoding jpeg at 1/%d scale, %dx%d", denom,
+                         dct_width, dct_height);
+                gdk_pixbuf_loader_set_size(loader, dct_width, dct_height);
+                image_data->dct_scaled = TRUE;
+                g_free(format_name);
+                return;
+            }
+        }
+    }
 
-    g_file_read_async(file,
-                      G_PRIORITY_DEFAULT,
-                      image_data->cancellable,
-                      xfce_backdrop_file_ready_cb,
-                      image_data);
-}
+    g_free(format_name);
 
+    gdk_pixbuf_loader_set_size(loader, target_width, target_height);
+}
 
+/* Runs in the worker thread */
 static void
 xfce_backdrop_loader_size_prepared_cb(GdkPixbufLoader *loader,
                                       gint width,
@@ -1536,68 +2270,135 @@ xfce_backdrop_loader_size_prepared_cb(GdkPixbufLoader *loader,
                                       gpointer user_data)
 {
     XfceBackdropImageData *image_data = user_data;
-    XfceBackdrop *backdrop = image_data->backdrop;
     gdouble xscale, yscale;
 
     TRACE("entering");
 
-    if(backdrop->priv->image_style == XFCE_BACKDROP_IMAGE_INVALID) {
+    if(image_data->image_style == XFCE_BACKDROP_IMAGE_INVALID) {
         g_warning("Invalid image style, setting to XFCE_BACKDROP_IMAGE_ZOOMED");
-        backdrop->priv->image_style = XFCE_BACKDROP_IMAGE_ZOOMED;
+        image_data->image_style = XFCE_BACKDROP_IMAGE_ZOOMED;
     }
 
-    switch(backdrop->priv->image_style) {
+    switch(image_data->image_style) {
         case XFCE_BACKDROP_IMAGE_CENTERED:
         case XFCE_BACKDROP_IMAGE_TILED:
             /* do nothing */
             break;
 
         case XFCE_BACKDROP_IMAGE_STRETCHED:
-            gdk_pixbuf_loader_set_size(loader,
-                                       backdrop->priv->width,
-                                       backdrop->priv->height);
+            xfce_backdrop_loader_set_size(loader, image_data, width, height,
+                                          image_data->width,
+                                          image_data->height);
             break;
 
         case XFCE_BACKDROP_IMAGE_SCALED:
-            xscale = (gdouble)backdrop->priv->width / width;
-            yscale = (gdouble)backdrop->priv->height / height;
+            xscale = (gdouble)image_data->width / width;
+            yscale = (gdouble)image_data->height / height;
             if(xscale < yscale) {
                 yscale = xscale;
             } else {
                 xscale = yscale;
             }
 
-            gdk_pixbuf_loader_set_size(loader,
-                                       width * xscale,
-                                       height * yscale);
+            xfce_backdrop_loader_set_size(loader, image_data, width, height,
+                                          width * xscale,
+                                          height * yscale);
             break;
 
         case XFCE_BACKDROP_IMAGE_ZOOMED:
         case XFCE_BACKDROP_IMAGE_SPANNING_SCREENS:
-            xscale = (gdouble)backdrop->priv->width / width;
-            yscale = (gdouble)backdrop->priv->height / height;
+            xscale = (gdouble)image_data->width / width;
+            yscale = (gdouble)image_data->height / height;
             if(xscale < yscale) {
                 xscale = yscale;
             } else {
                 yscale = xscale;
             }
 
-            gdk_pixbuf_loader_set_size(loader,
-                                       width * xscale,
-                                       height * yscale);
+            xfce_backdrop_loader_set_size(loader, image_data, width, height,
+                                          width * xscale,
+                                          height * yscale);
             break;
 
         default:
-            g_critical("Invalid image style: %d\n", (gint)backdrop->priv->image_style);
+            g_critical("Invalid image style: %d\n", (gint)image_data->image_style);
     }
 }
 
-static void
-xfce_backdrop_loader_closed_cb(GdkPixbufLoader *loader,
-                               XfceBackdropImageData *image_data)
+/* Runs in the worker thread.  Returns the decoded image or NULL if it
+ * failed to load or the request was canceled. */
+static GdkPixbuf *
+xfce_backdrop_load_image(XfceBackdropImageData *image_data)
 {
-    XfceBackdrop *backdrop = image_data->backdrop;
-    GdkPixbuf *final_image, *image, *tmp;
+    GFile *file;
+    GFileInputStream *stream;
+    GdkPixbufLoader *loader;
+    GdkPixbuf *image = NULL;
+    guchar *buffer;
+    gssize bytes;
+    gboolean loader_open = TRUE;
+
+    TRACE("entering");
+
+    file = g_file_new_for_path(image_data->image_path);
+    stream = g_file_read(file, image_data->cancellable, NULL);
+    g_object_unref(file);
+
+    /* If this fails then we will only display the selected backdrop color */
+    if(stream == NULL)
+        return NULL;
+
+    loader = gdk_pixbuf_loader_new();
+    g_signal_connect(loader, "size-prepared",
+                     G_CALLBACK(xfce_backdrop_loader_size_prepared_cb),
+                     image_data);
+
+    buffer = g_new(guchar, XFCE_BACKDROP_BUFFER_SIZE);
+
+    /* Every read checks the cancellable, so a superseded request stops
+     * decoding at the next chunk */
+    while((bytes = g_input_stream_read(G_INPUT_STREAM(stream),
+                                       buffer,
+                                       XFCE_BACKDROP_BUFFER_SIZE,
+                                       image_data->cancellable,
+                                       NULL)) > 0)
+    {
+        if(!gdk_pixbuf_loader_write(loader, buffer, bytes, NULL)) {
+            /* If we got here, the loader will be closed, and will not
+             * accept further writes. */
+            loader_open = FALSE;
+            break;
+        }
+    }
+
+    g_input_stream_close(G_INPUT_STREAM(stream), NULL, NULL);
+    g_object_unref(stream);
+    g_free(buffer);
+
+    /* If there was an error reading the stream or it completed, close the
+     * pixbuf loader (which will handle both conditions) */
+    if(loader_open)
+        gdk_pixbuf_loader_close(loader, NULL);
+
+    if(!g_cancellable_is_cancelled(image_data->cancellable)) {
+        image = gdk_pixbuf_loader_get_pixbuf(loader);
+        if(image)
+            g_object_ref(image);
+    }
+
+    g_object_unref(loader);
+
+    return image;
+}
+
+/* Runs in the worker thread.  Creates the canvas and composites the image
+ * on top of it.  @image_loaded is set to FALSE if there is an image that
+ * failed to load, so only the canvas is there. */
+static GdkPixbuf *
+xfce_backdrop_composite(XfceBackdropImageData *image_data,
+                        gboolean *image_loaded)
+{
+    GdkPixbuf *final_image, *image = NULL, *tmp;
     gint i, j;
     gint w, h, iw = 0, ih = 0;
     XfceBackdropImageStyle istyle;
@@ -1607,36 +2408,35 @@ xfce_backdrop_loader_closed_cb(GdkPixbufLoader *loader,
 
     TRACE("entering");
 
-    g_return_if_fail(XFCE_IS_BACKDROP(backdrop));
+    *image_loaded = TRUE;
 
-    /* canceled? quit now */
-    if(g_cancellable_is_cancelled(image_data->cancellable)) {
-        xfce_backdrop_image_data_release(image_data);
-        g_free(image_data);
-        return;
+    if(image_data->image_path) {
+        image = xfce_backdrop_load_image(image_data);
+        *image_loaded = image != NULL;
+
+        /* canceled? quit now */
+        if(g_cancellable_is_cancelled(image_data->cancellable)) {
+            if(image)
+                g_object_unref(image);
+            return NULL;
+        }
     }
 
-    image = gdk_pixbuf_loader_get_pixbuf(loader);
     if(image) {
         iw = gdk_pixbuf_get_width(image);
         ih = gdk_pixbuf_get_height(image);
     }
 
-    if(backdrop->priv->width == 0 || backdrop->priv->height == 0) {
-        w = iw;
-        h = ih;
-    } else {
-        w = backdrop->priv->width;
-        h = backdrop->priv->height;
-    }
-    
-    istyle = backdrop->priv->image_style;
-    
+    w = image_data->width;
+    h = image_data->height;
+
+    istyle = image_data->image_style;
+
     /* if the image is the same as the screen size, there's no reason to do
      * any scaling at all */
     if(w == iw && h == ih)
         istyle = XFCE_BACKDROP_IMAGE_CENTERED;
-    
+
     /* if we don't need to do any scaling, don't do any interpolation.  this
      * fixes a problem where hyper/bilinear filtering causes blurriness in
      * some images.  http://bugzilla.xfce.org/show_bug.cgi?id=2939 */
@@ -1645,27 +2445,19 @@ xfce_backdrop_loader_closed_cb(GdkPixbufLoader *loader,
     {
         interp = GDK_INTERP_NEAREST;
     } else {
-        /* if the screen has a bit depth of less than 24bpp, using bilinear
-         * filtering looks crappy (mainly with gradients). */
-        if(backdrop->priv->bpp < 24)
-            interp = GDK_INTERP_HYPER;
-        else
-            interp = GDK_INTERP_BILINEAR;
+        /* low depth visuals used to get GDK_INTERP_HYPER here to make the
+         * gradients look less crappy; the canvas is dithered for them
+         * now, so bilinear is good enough everywhere */
+        interp = GDK_INTERP_BILINEAR;
     }
 
-    final_image = xfce_backdrop_generate_canvas(backdrop);
-
-    /* no image and not canceled? return just the canvas */
-    if(!image && !g_cancellable_is_cancelled(image_data->cancellable)) {
-        XF_DEBUG("image failed to load, displaying canvas only");
-        backdrop->priv->pix = final_image;
-
-        g_signal_emit(G_OBJECT(backdrop), backdrop_signals[BACKDROP_READY], 0);
+    final_image = xfce_backdrop_generate_canvas(image_data);
 
-        backdrop->priv->image_data = NULL;
-        xfce_backdrop_image_data_release(image_data);
-        g_free(image_data);
-        return;
+    /* no image? return just the canvas */
+    if(!image) {
+        if(image_data->image_path)
+            XF_DEBUG("image failed to load, displaying canvas only");
+        return final_image;
     }
 
     switch(istyle) {
@@ -1678,20 +2470,15 @@ xfce_backdrop_loader_closed_cb(GdkPixbufLoader *loader,
                     MIN(w, iw), MIN(h, ih), xo, yo, 1.0, 1.0,
                     interp, 255);
             break;
-        
+
         case XFCE_BACKDROP_IMAGE_TILED:
             tmp = gdk_pixbuf_new(GDK_COLORSPACE_RGB, TRUE, 8, w, h);
-            /* Now that the image has been loaded, recalculate the image
-             * size because gdk_pixbuf_get_file_info doesn't always return
-             * the correct size */
-            iw = gdk_pixbuf_get_width(image);
-            ih = gdk_pixbuf_get_height(image);
 
             for(i = 0; (i * iw) < w; i++) {
                 for(j = 0; (j * ih) < h; j++) {
                     gint newx = iw * i, newy = ih * j;
                     gint neww = iw, newh = ih;
-                    
+
                     if((newx + neww) > w)
                         neww = w - newx;
                     if((newy + newh) > h)
@@ -1701,17 +2488,25 @@ xfce_backdrop_loader_closed_cb(GdkPixbufLoader *loader,
                             neww, newh, tmp, newx, newy);
                 }
             }
-            
+
             gdk_pixbuf_composite(tmp, final_image, 0, 0, w, h,
                     0, 0, 1.0, 1.0, interp, 255);
             g_object_unref(G_OBJECT(tmp));
             break;
-        
+
         case XFCE_BACKDROP_IMAGE_STRETCHED:
+            /* the loader has already scaled the image to fit, unless it
+             * was only decoded at a reduced JPEG scale */
+            if(image_data->dct_scaled) {
+                xscale = (gdouble)w / iw;
+                yscale = (gdouble)h / ih;
+            } else
+                xscale = yscale = 1;
+
             gdk_pixbuf_composite(image, final_image, 0, 0, w, h,
-                    0, 0, 1, 1, interp, 255);
+                    0, 0, xscale, yscale, interp, 255);
             break;
-        
+
         case XFCE_BACKDROP_IMAGE_SCALED:
             xscale = (gdouble)w / iw;
             yscale = (gdouble)h / ih;
@@ -1728,10 +2523,12 @@ xfce_backdrop_loader_closed_cb(GdkPixbufLoader *loader,
             dy = yo;
 
             gdk_pixbuf_composite(image, final_image, dx, dy,
-                    iw * xscale, ih * yscale, xo, yo, 1, 1,
+                    iw * xscale, ih * yscale, xo, yo,
+                    image_data->dct_scaled ? xscale : 1,
+                    image_data->dct_scaled ? yscale : 1,
                     interp, 255);
             break;
-        
+
         case XFCE_BACKDROP_IMAGE_ZOOMED:
         case XFCE_BACKDROP_IMAGE_SPANNING_SCREENS:
             xscale = (gdouble)w / iw;
@@ -1747,85 +2544,240 @@ xfce_backdrop_loader_closed_cb(GdkPixbufLoader *loader,
             }
 
             gdk_pixbuf_composite(image, final_image, 0, 0,
-                    w, h, xo, yo, 1, 1, interp, 255);
+                    w, h, xo, yo,
+                    image_data->dct_scaled ? xscale : 1,
+                    image_data->dct_scaled ? yscale : 1,
+                    interp, 255);
             break;
-        
+
         default:
             g_critical("Invalid image style: %d\n", (gint)istyle);
     }
 
-    /* keep the backdrop and emit the signal if it hasn't been canceled */
-    if(!g_cancellable_is_cancelled(image_data->cancellable)) {
-        backdrop->priv->pix = final_image;
-        g_signal_emit(G_OBJECT(backdrop), backdrop_signals[BACKDROP_READY], 0);
+    g_object_unref(image);
+
+    return final_image;
+}
+
+/* Converts @pix into an image surface in cairo's native format, which is
+ * also what the X server uses for 24 and 32 bit visuals.  Doing this once
+ * here means painting the backdrop is a plain copy on the main thread. */
+static cairo_surface_t *
+xfce_backdrop_surface_from_pixbuf(GdkPixbuf *pix)
+{
+    cairo_surface_t *surface;
+    gboolean has_alpha;
+    gint width, height, n_channels, rowstride, stride;
+    const guchar *src_pixels, *src;
+    guchar *dst_pixels;
+    guint32 *dst;
+    gint x, y;
+
+    has_alpha = gdk_pixbuf_get_has_alpha(pix);
+    width = gdk_pixbuf_get_width(pix);
+    height = gdk_pixbuf_get_height(pix);
+    n_channels = gdk_pixbuf_get_n_channels(pix);
+    rowstride = gdk_pixbuf_get_rowstride(pix);
+    src_pixels = gdk_pixbuf_get_pixels(pix);
+
+    surface = cairo_image_surface_create(has_alpha ? CAIRO_FORMAT_ARGB32
+                                                   : CAIRO_FORMAT_RGB24,
+                                         width, height);
+    if(cairo_surface_status(surface) != CAIRO_STATUS_SUCCESS) {
+        cairo_surface_destroy(surface);
+        return NULL;
     }
 
-    backdrop->priv->image_data = NULL;
-    xfce_backdrop_image_data_release(image_data);
-    g_free(image_data);
+    cairo_surface_flush(surface);
+    dst_pixels = cairo_image_surface_get_data(surface);
+    stride = cairo_image_surface_get_stride(surface);
+
+    for(y = 0; y < height; y++) {
+        src = src_pixels + (gsize)y * rowstride;
+        dst = (guint32 *)(dst_pixels + (gsize)y * stride);
+
+        if(!has_alpha) {
+            for(x = 0; x < width; x++, src += n_channels)
+                dst[x] = 0xff000000 | (src[0] << 16) | (src[1] << 8) | src[2];
+        } else {
+            for(x = 0; x < width; x++, src += n_channels) {
+                guint a = src[3], r, g, b;
+
+                /* cairo wants premultiplied alpha, t / 255 rounded */
+                r = ((src[0] * a + 0x80) + ((src[0] * a + 0x80) >> 8)) >> 8;
+                g = ((src[1] * a + 0x80) + ((src[1] * a + 0x80) >> 8)) >> 8;
+                b = ((src[2] * a + 0x80) + ((src[2] * a + 0x80) >> 8)) >> 8;
+
+                dst[x] = (a << 24) | (r << 16) | (g << 8) | b;
+            }
+        }
+    }
+
+    cairo_surface_mark_dirty(surface);
+
+    return surface;
 }
 
-static void
-xfce_backdrop_file_ready_cb(GObject *source_object,
-                            GAsyncResult *res,
-                            gpointer user_data)
+/* Runs in the worker thread.  Renders the backdrop straight into the
+ * surface it is going to be painted from.  See xfce_backdrop_composite()
+ * for @image_loaded. */
+static cairo_surface_t *
+xfce_backdrop_render(XfceBackdropImageData *image_data,
+                     gboolean *image_loaded)
 {
-    GFile *file = G_FILE(source_object);
-    XfceBackdropImageData *image_data = user_data;
-    GFileInputStream *input_stream = g_file_read_finish(file, res, NULL);
+    GdkPixbuf *pix;
+    cairo_surface_t *surface;
 
-    TRACE("entering");
+    pix = xfce_backdrop_composite(image_data, image_loaded);
+    if(!pix)
+        return NULL;
 
-    /* Finished with the file, clean it up */
-    g_object_unref(file);
+    surface = xfce_backdrop_surface_from_pixbuf(pix);
+    g_object_unref(pix);
 
-    /* If this fails then close the loader, it will only display the selected
-     * backdrop color */
-    if(input_stream == NULL) {
-        gdk_pixbuf_loader_close(image_data->loader, NULL);
-        return;
+    return surface;
+}
+
+/* Runs in the worker thread.  Builds the key the finished backdrop is
+ * cached under; it covers everything that goes into xfce_backdrop_render()
+ * except the state of the source image, which is returned in @mtime and
+ * @size.  Returns NULL if the image can't be stat()ed, in which case the
+ * result isn't cached. */
+static gchar *
+xfce_backdrop_image_data_get_cache_key(XfceBackdropImageData *image_data,
+                                       gint64 *mtime,
+                                       gint64 *size)
+{
+    GStatBuf st;
+
+    *mtime = *size = 0;
+
+    if(image_data->image_path) {
+        if(g_stat(image_data->image_path, &st) != 0)
+            return NULL;
+
+        *mtime = st.st_mtime;
+        *size = st.st_size;
     }
 
-    g_input_stream_read_async(G_INPUT_STREAM(input_stream),
-                              image_data->image_buffer,
-                              XFCE_BACKDROP_BUFFER_SIZE,
-                              G_PRIORITY_LOW,
-                              image_data->cancellable,
-                              xfce_backdrop_file_input_stream_ready_cb,
-                              image_data);
+    return g_strdup_printf("%s:%dx%d:%d:%d:%d:%04x%04x%04x:%04x%04x%04x",
+                           image_data->image_path ? image_data->image_path : "",
+                           image_data->width, image_data->height,
+                           image_data->bpp,
+                           image_data->image_style,
+                           image_data->color_style,
+                           image_data->color1.red,
+                           image_data->color1.green,
+                           image_data->color1.blue,
+                           image_data->color2.red,
+                           image_data->color2.green,
+                           image_data->color2.blue);
 }
 
+/* Worker thread entry point, hands the result back to the main loop */
 static void
-xfce_backdrop_file_input_stream_ready_cb(GObject *source_object,
-                                         GAsyncResult *res,
-                                         gpointer user_data)
+xfce_backdrop_generate_thread(gpointer data,
+                              gpointer user_data)
 {
-    GInputStream *stream = G_INPUT_STREAM(source_object);
-    XfceBackdropImageData *image_data = user_data;
-    gssize bytes = g_input_stream_read_finish(stream, res, NULL);
+    XfceBackdropImageData *image_data = data;
+    cairo_surface_t *surface = NULL, *rendered = NULL;
+    gchar *key = NULL, *memory_key = NULL;
+    gint64 mtime, size;
+    gboolean image_loaded = TRUE;
 
-    if(bytes == -1 || bytes == 0) {
-        /* If there was an error reading the stream or it completed, clean
-         * up and close the pixbuf loader (which will handle both conditions) */
-        g_input_stream_close(stream, image_data->cancellable, NULL);
-        g_object_unref(source_object);
+    if(g_cancellable_is_cancelled(image_data->cancellable)) {
+        g_idle_add(xfce_backdrop_generate_done, image_data);
+        return;
+    }
 
-        gdk_pixbuf_loader_close(image_data->loader, NULL);
+    key = xfce_backdrop_image_data_get_cache_key(image_data, &mtime, &size);
+    if(!key) {
+        image_data->surface = xfce_backdrop_render(image_data, &image_loaded);
+        g_idle_add(xfce_backdrop_generate_done, image_data);
         return;
     }
 
-    if(gdk_pixbuf_loader_write(image_data->loader, image_data->image_buffer, bytes, NULL)) {
-        g_input_stream_read_async(stream,
-                                  image_data->image_buffer,
-                                  XFCE_BACKDROP_BUFFER_SIZE,
-                                  G_PRIORITY_LOW,
-                                  image_data->cancellable,
-                                  xfce_backdrop_file_input_stream_ready_cb,
-                                  image_data);
-    } else {
-        /* If we got here, the loader will be closed, and will not accept
-         * further writes. */
-        g_input_stream_close(stream, image_data->cancellable, NULL);
-        g_object_unref(source_object);
+    /* another workspace or monitor may already show the same thing */
+    memory_key = g_strdup_printf("%s:%" G_GINT64_FORMAT ":%" G_GINT64_FORMAT,
+                                 key, mtime, size);
+    surface = xfce_backdrop_cache_lookup(memory_key);
+
+    if(!surface) {
+        /* otherwise try what we rendered in a previous session, a plain
+         * canvas isn't worth the disk space though */
+        if(image_data->image_path)
+            surface = xfce_backdrop_cache_load_file(key, mtime, size);
+
+        /* and if that fails too, do it the hard way */
+        if(!surface) {
+            surface = xfce_backdrop_render(image_data, &image_loaded);
+            if(surface && image_data->image_path && image_loaded)
+                rendered = cairo_surface_reference(surface);
+        }
+
+        /* a canvas standing in for an image that failed to load must not
+         * be found under the image's key, the failure may be temporary */
+        if(surface && image_loaded) {
+            cairo_surface_t *cached = xfce_backdrop_cache_insert(memory_key,
+                                                                 surface);
+            cairo_surface_destroy(surface);
+            surface = cached;
+        }
+    }
+
+    /* image_data belongs to the main thread once this is queued */
+    image_data->surface = surface;
+    g_idle_add(xfce_backdrop_generate_done, image_data);
+
+    if(rendered) {
+        xfce_backdrop_cache_save_file(key, mtime, size, rendered);
+        cairo_surface_destroy(rendered);
     }
+
+    g_free(memory_key);
+    g_free(key);
+}
+
+/* Back on the main thread with the finished image */
+static gboolean
+xfce_backdrop_generate_done(gpointer user_data)
+{
+    XfceBackdropImageData *image_data = user_data;
+    XfceBackdrop *backdrop = image_data->backdrop;
+
+    TRACE("entering");
+
+    /* a prefetched image waits for the next cycle */
+    if(image_data->prefetch) {
+        if(backdrop != NULL && image_data->surface != NULL
+           && !g_cancellable_is_cancelled(image_data->cancellable))
+        {
+            image_data->finished = TRUE;
+            return FALSE;
+        }
+
+        xfce_backdrop_image_data_release(image_data);
+        return FALSE;
+    }
+
+    /* keep the backdrop and emit the signal if it hasn't been canceled */
+    if(backdrop != NULL && image_data->surface != NULL
+       && !g_cancellable_is_cancelled(image_data->cancellable))
+    {
+        backdrop->priv->image_data = NULL;
+        image_data->backdrop = NULL;
+
+        xfce_backdrop_clear_cached_image(backdrop);
+        backdrop->priv->surface = image_data->surface;
+        image_data->surface = NULL;
+
+        g_signal_emit(G_OBJECT(backdrop), backdrop_signals[BACKDROP_READY], 0);
+
+        /* get the next cycle ready while nothing else is going on */
+        xfce_backdrop_prefetch_next(backdrop);
+    }
+
+    xfce_backdrop_image_data_release(image_data);
+
+    return FALSE;
 }
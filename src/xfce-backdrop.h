@@ -24,6 +24,7 @@
 #include <glib-object.h>
 #include <gdk/gdk.h>
 #include <gdk-pixbuf/gdk-pixbuf.h>
+#include <cairo.h>
 
 G_BEGIN_DECLS
 
@@ -146,7 +147,9 @@ gboolean xfce_backdrop_get_random_order  (XfceBackdrop *backdrop);
 void xfce_backdrop_force_cycle           (XfceBackdrop *backdrop);
 
 
-GdkPixbuf *xfce_backdrop_get_pixbuf      (XfceBackdrop *backdrop);
+cairo_surface_t *xfce_backdrop_get_surface(XfceBackdrop *backdrop);
+
+cairo_surface_t *xfce_backdrop_take_previous_surface(XfceBackdrop *backdrop);
 
 void xfce_backdrop_generate_async        (XfceBackdrop *backdrop);
 
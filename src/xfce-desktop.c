@@ -83,6 +83,7 @@
 #include "xfce-desktop.h"
 #include "xfce-desktop-enum-types.h"
 #include "xfce-workspace.h"
+#include "xfce-backdrop-cache.h"
 
 /* disable setting the x background for bug 7442 */
 //#define DISABLE_FOR_BUG7442
@@ -105,6 +106,10 @@ struct _XfceDesktopPriv
     gboolean single_workspace_mode;
     gint single_workspace_num;
 
+    guint backdrop_cache_size;
+    guint backdrop_fade_duration;
+    GList *backdrop_fades;
+
     SessionLogoutFunc session_logout_func;
 
     guint32 grab_time;
@@ -140,6 +145,8 @@ enum
 #endif
     PROP_SINGLE_WORKSPACE_MODE,
     PROP_SINGLE_WORKSPACE_NUMBER,
+    PROP_BACKDROP_CACHE_SIZE,
+    PROP_BACKDROP_FADE_DURATION,
 };
 
 
@@ -214,6 +221,25 @@ xfce_desktop_ensure_system_font_size(XfceDesktop *desktop)
     return desktop->priv->system_font_size;
 }
 
+/* the icon view keeps the wallpaper with the icons on top off-screen, so
+ * it needs to know where the wallpaper is and when it changes.  while a
+ * fade runs the wallpaper is redrawn every frame, so the icon view is told
+ * there's none until the last fade is over. */
+static void
+xfce_desktop_update_icon_view_background(XfceDesktop *desktop)
+{
+    GdkPixmap *pmap = desktop->priv->bg_pixmap;
+
+    if(!desktop->priv->icon_view)
+        return;
+
+    if(desktop->priv->backdrop_fades != NULL)
+        pmap = NULL;
+
+    xfdesktop_icon_view_set_background(XFDESKTOP_ICON_VIEW(desktop->priv->icon_view),
+                                       GDK_IS_PIXMAP(pmap) ? pmap : NULL);
+}
+
 static void
 xfce_desktop_setup_icon_view(XfceDesktop *desktop)
 {
@@ -265,6 +291,7 @@ xfce_desktop_setup_icon_view(XfceDesktop *desktop)
         }
         xfdesktop_icon_view_set_center_text (XFDESKTOP_ICON_VIEW(desktop->priv->icon_view),
                                              desktop->priv->icons_center_text);
+        xfce_desktop_update_icon_view_background(desktop);
 
         gtk_widget_show(desktop->priv->icon_view);
         gtk_container_add(GTK_CONTAINER(desktop), desktop->priv->icon_view);
@@ -362,9 +389,178 @@ create_bg_pixmap(GdkScreen *gscreen, gpointer user_data)
     gdk_window_set_back_pixmap(gtk_widget_get_window(GTK_WIDGET(desktop)),
                                desktop->priv->bg_pixmap, FALSE);
 
+#ifdef ENABLE_DESKTOP_ICONS
+    xfce_desktop_update_icon_view_background(desktop);
+#endif
+
     return desktop->priv->bg_pixmap;
 }
 
+/* A crossfade from the image a monitor showed before its backdrop cycled
+ * to the new one.  Both images are finished surfaces, so each frame is
+ * just two paints into the background pixmap. */
+typedef struct
+{
+    XfceDesktop *desktop;
+    cairo_surface_t *from;
+    cairo_surface_t *to;
+    GdkRectangle rect;
+    GdkRegion *clip_region;
+    gint64 start_time;
+    guint timeout_id;
+} XfceDesktopFade;
+
+#define XFCE_DESKTOP_FADE_FRAME_INTERVAL 16  /* ms, about 60 fps */
+
+static void
+xfce_desktop_paint_backdrop(XfceDesktop *desktop,
+                            cairo_surface_t *surface,
+                            gdouble alpha,
+                            GdkRectangle *rect,
+                            GdkRegion *clip_region)
+{
+    cairo_t *cr;
+
+    cr = gdk_cairo_create(GDK_DRAWABLE(desktop->priv->bg_pixmap));
+    /* the surface is already in the pixmap's format, so for opaque
+     * backdrops this ends up as a straight copy */
+    cairo_set_source_surface(cr, surface, rect->x, rect->y);
+
+    /* clip the area so we don't draw over a previous wallpaper */
+    if(clip_region != NULL) {
+        gdk_cairo_region(cr, clip_region);
+        cairo_clip(cr);
+    }
+
+    if(alpha < 1.0)
+        cairo_paint_with_alpha(cr, alpha);
+    else
+        cairo_paint(cr);
+
+    cairo_destroy(cr);
+
+#ifdef ENABLE_DESKTOP_ICONS
+    if(desktop->priv->icon_view) {
+        xfdesktop_icon_view_background_changed(XFDESKTOP_ICON_VIEW(desktop->priv->icon_view),
+                                               rect);
+    }
+#endif
+
+    /* tell gtk to redraw the repainted area */
+    gtk_widget_queue_draw_area(GTK_WIDGET(desktop), rect->x, rect->y,
+                               rect->width, rect->height);
+}
+
+static void
+xfce_desktop_fade_free(XfceDesktopFade *fade)
+{
+    XfceDesktop *desktop = fade->desktop;
+
+    if(fade->timeout_id != 0)
+        g_source_remove(fade->timeout_id);
+
+    desktop->priv->backdrop_fades = g_list_remove(desktop->priv->backdrop_fades,
+                                                  fade);
+
+    cairo_surface_destroy(fade->from);
+    cairo_surface_destroy(fade->to);
+    if(fade->clip_region != NULL)
+        gdk_region_destroy(fade->clip_region);
+
+    g_slice_free(XfceDesktopFade, fade);
+
+#ifdef ENABLE_DESKTOP_ICONS
+    if(desktop->priv->backdrop_fades == NULL)
+        xfce_desktop_update_icon_view_background(desktop);
+#endif
+}
+
+static gboolean
+xfce_desktop_fade_step(gpointer user_data)
+{
+    XfceDesktopFade *fade = user_data;
+    XfceDesktop *desktop = fade->desktop;
+    gdouble progress;
+
+    /* fades are stopped whenever the pixmap is released or replaced, this
+     * is just a safety net */
+    if(!GDK_IS_PIXMAP(desktop->priv->bg_pixmap)) {
+        fade->timeout_id = 0;
+        xfce_desktop_fade_free(fade);
+        return FALSE;
+    }
+
+    /* go by the clock rather than counting frames, so a busy main loop
+     * makes the fade choppier but not longer */
+    progress = (g_get_monotonic_time() - fade->start_time)
+               / (desktop->priv->backdrop_fade_duration * 1000.0);
+
+    if(progress < 1.0) {
+        xfce_desktop_paint_backdrop(desktop, fade->from, 1.0,
+                                    &fade->rect, fade->clip_region);
+        xfce_desktop_paint_backdrop(desktop, fade->to, progress,
+                                    &fade->rect, fade->clip_region);
+        return TRUE;
+    }
+
+    xfce_desktop_paint_backdrop(desktop, fade->to, 1.0,
+                                &fade->rect, fade->clip_region);
+
+    /* do this again so apps watching the root win notice the update */
+    set_real_root_window_pixmap(desktop->priv->gscreen,
+                                desktop->priv->bg_pixmap);
+
+    fade->timeout_id = 0;
+    xfce_desktop_fade_free(fade);
+
+    return FALSE;
+}
+
+static void
+xfce_desktop_start_fade(XfceDesktop *desktop,
+                        cairo_surface_t *from,
+                        cairo_surface_t *to,
+                        GdkRectangle *rect,
+                        GdkRegion *clip_region)
+{
+    XfceDesktopFade *fade = g_slice_new0(XfceDesktopFade);
+
+    fade->desktop = desktop;
+    fade->from = cairo_surface_reference(from);
+    fade->to = cairo_surface_reference(to);
+    fade->rect = *rect;
+    if(clip_region != NULL)
+        fade->clip_region = gdk_region_copy(clip_region);
+    fade->start_time = g_get_monotonic_time();
+    fade->timeout_id = g_timeout_add(XFCE_DESKTOP_FADE_FRAME_INTERVAL,
+                                     xfce_desktop_fade_step, fade);
+
+    desktop->priv->backdrop_fades = g_list_prepend(desktop->priv->backdrop_fades,
+                                                   fade);
+
+#ifdef ENABLE_DESKTOP_ICONS
+    xfce_desktop_update_icon_view_background(desktop);
+#endif
+}
+
+/* Stops the fades overlapping @rect, or all of them if @rect is NULL */
+static void
+xfce_desktop_stop_fades(XfceDesktop *desktop,
+                        GdkRectangle *rect)
+{
+    GList *l, *next;
+    GdkRectangle overlap;
+
+    for(l = desktop->priv->backdrop_fades; l != NULL; l = next) {
+        XfceDesktopFade *fade = l->data;
+
+        next = l->next;
+
+        if(rect == NULL || gdk_rectangle_intersect(&fade->rect, rect, &overlap))
+            xfce_desktop_fade_free(fade);
+    }
+}
+
 static void
 backdrop_changed_cb(XfceBackdrop *backdrop, gpointer user_data)
 {
@@ -477,11 +673,11 @@ backdrop_changed_cb(XfceBackdrop *backdrop, gpointer user_data)
 
     if(rect.width != 0 && rect.height != 0) {
         /* get the composited backdrop pixmap */
-        GdkPixbuf *pix = xfce_backdrop_get_pixbuf(backdrop);
-        cairo_t *cr;
+        cairo_surface_t *surface = xfce_backdrop_get_surface(backdrop);
+        cairo_surface_t *previous;
 
         /* create the backdrop if needed */
-        if(!pix) {
+        if(!surface) {
             xfce_backdrop_generate_async(backdrop);
 
             if(clip_region != NULL)
@@ -495,7 +691,7 @@ backdrop_changed_cb(XfceBackdrop *backdrop, gpointer user_data)
             pmap = create_bg_pixmap(gscreen, desktop);
 
             if(!GDK_IS_PIXMAP(pmap)) {
-                g_object_unref(pix);
+                cairo_surface_destroy(surface);
 
                 if(clip_region != NULL)
                     gdk_region_destroy(clip_region);
@@ -504,20 +700,19 @@ backdrop_changed_cb(XfceBackdrop *backdrop, gpointer user_data)
             }
         }
 
-        cr = gdk_cairo_create(GDK_DRAWABLE(pmap));
-        gdk_cairo_set_source_pixbuf(cr, pix, rect.x, rect.y);
-
-        /* clip the area so we don't draw over a previous wallpaper */
-        if(clip_region != NULL) {
-            gdk_cairo_region(cr, clip_region);
-            cairo_clip(cr);
-        }
+        /* whatever was fading in here is out of date now */
+        xfce_desktop_stop_fades(desktop, &rect);
 
-        cairo_paint(cr);
+        /* if the backdrop just cycled, fade over from the old image,
+         * otherwise simply paint the new one */
+        previous = xfce_backdrop_take_previous_surface(backdrop);
+        if(previous != NULL && desktop->priv->backdrop_fade_duration > 0)
+            xfce_desktop_start_fade(desktop, previous, surface, &rect, clip_region);
+        else
+            xfce_desktop_paint_backdrop(desktop, surface, 1.0, &rect, clip_region);
 
-        /* tell gtk to redraw the repainted area */
-        gtk_widget_queue_draw_area(GTK_WIDGET(desktop), rect.x, rect.y,
-                                   rect.width, rect.height);
+        if(previous != NULL)
+            cairo_surface_destroy(previous);
 
         set_imgfile_root_property(desktop,
                                   xfce_backdrop_get_image_filename(backdrop),
@@ -526,8 +721,7 @@ backdrop_changed_cb(XfceBackdrop *backdrop, gpointer user_data)
         /* do this again so apps watching the root win notice the update */
         set_real_root_window_pixmap(gscreen, pmap);
 
-        g_object_unref(G_OBJECT(pix));
-        cairo_destroy(cr);
+        cairo_surface_destroy(surface);
         gtk_widget_show(GTK_WIDGET(desktop));
     }
 
@@ -551,11 +745,18 @@ screen_size_changed_cb(GdkScreen *gscreen, gpointer user_data)
     if(current_workspace < 0)
         return;
 
+    /* the running fades paint old-size backdrops at old positions, the
+     * new backdrops are requested below */
+    xfce_desktop_stop_fades(desktop, NULL);
+
     /* release the bg_pixmap since the dimensions may have changed */
     if(desktop->priv->bg_pixmap) {
         g_object_unref(desktop->priv->bg_pixmap);
         desktop->priv->bg_pixmap = NULL;
     }
+#ifdef ENABLE_DESKTOP_ICONS
+    xfce_desktop_update_icon_view_background(desktop);
+#endif
 
     /* special case for 1 backdrop to handle xinerama stretching */
     if(xfce_workspace_get_xinerama_stretch(desktop->priv->workspaces[current_workspace])) {
@@ -628,6 +829,13 @@ workspace_backdrop_changed_cb(XfceWorkspace *workspace,
         if(!xfce_workspace_get_xinerama_stretch(workspace) || monitor == 0) {
             backdrop_changed_cb(backdrop, user_data);
         }
+    } else {
+        /* nobody saw the old image, so there is nothing to fade from when
+         * this workspace gets shown */
+        cairo_surface_t *previous = xfce_backdrop_take_previous_surface(backdrop);
+
+        if(previous != NULL)
+            cairo_surface_destroy(previous);
     }
 }
 
@@ -889,6 +1097,23 @@ xfce_desktop_class_init(XfceDesktopClass *klass)
                                                      0, G_MAXINT16, 0,
                                                      XFDESKTOP_PARAM_FLAGS));
 
+    /* in MiB, shared by all backdrops of all screens */
+    g_object_class_install_property(gobject_class, PROP_BACKDROP_CACHE_SIZE,
+                                    g_param_spec_uint("backdrop-cache-size",
+                                                      "backdrop-cache-size",
+                                                      "backdrop-cache-size",
+                                                      0, 4096,
+                                                      XFCE_BACKDROP_CACHE_DEFAULT_SIZE,
+                                                      XFDESKTOP_PARAM_FLAGS));
+
+    /* in milliseconds, 0 switches images without fading */
+    g_object_class_install_property(gobject_class, PROP_BACKDROP_FADE_DURATION,
+                                    g_param_spec_uint("backdrop-fade-duration",
+                                                      "backdrop-fade-duration",
+                                                      "backdrop-fade-duration",
+                                                      0, 10000, 0,
+                                                      XFDESKTOP_PARAM_FLAGS));
+
 #undef XFDESKTOP_PARAM_FLAGS
 }
 
@@ -905,6 +1130,9 @@ xfce_desktop_init(XfceDesktop *desktop)
     /* Can focus is needed for the gtk_grab_add/remove commands */
     gtk_widget_set_can_focus(GTK_WIDGET(desktop), TRUE);
     gtk_window_set_resizable(GTK_WINDOW(desktop), FALSE);
+
+    /* the cache starts out at this size until xfconf says otherwise */
+    desktop->priv->backdrop_cache_size = XFCE_BACKDROP_CACHE_DEFAULT_SIZE;
 }
 
 static void
@@ -969,6 +1197,16 @@ xfce_desktop_set_property(GObject *object,
                                                      g_value_get_int(value));
             break;
 
+        case PROP_BACKDROP_CACHE_SIZE:
+            desktop->priv->backdrop_cache_size = g_value_get_uint(value);
+            xfce_backdrop_cache_set_max_size((gsize)desktop->priv->backdrop_cache_size
+                                             * 1024 * 1024);
+            break;
+
+        case PROP_BACKDROP_FADE_DURATION:
+            desktop->priv->backdrop_fade_duration = g_value_get_uint(value);
+            break;
+
         default:
             G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
             break;
@@ -1014,6 +1252,14 @@ xfce_desktop_get_property(GObject *object,
             g_value_set_int(value, desktop->priv->single_workspace_num);
             break;
 
+        case PROP_BACKDROP_CACHE_SIZE:
+            g_value_set_uint(value, desktop->priv->backdrop_cache_size);
+            break;
+
+        case PROP_BACKDROP_FADE_DURATION:
+            g_value_set_uint(value, desktop->priv->backdrop_fade_duration);
+            break;
+
         default:
             G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
             break;
@@ -1081,6 +1327,13 @@ xfce_desktop_realize(GtkWidget *widget)
                            SINGLE_WORKSPACE_NUMBER, G_TYPE_INT,
                            G_OBJECT(desktop), "single-workspace-number");
 
+    xfconf_g_property_bind(desktop->priv->channel,
+                           BACKDROP_CACHE_SIZE, G_TYPE_UINT,
+                           G_OBJECT(desktop), "backdrop-cache-size");
+    xfconf_g_property_bind(desktop->priv->channel,
+                           BACKDROP_FADE_DURATION, G_TYPE_UINT,
+                           G_OBJECT(desktop), "backdrop-fade-duration");
+
     /* watch for workspace changes */
     g_signal_connect(desktop->priv->wnck_screen, "active-workspace-changed",
                      G_CALLBACK(workspace_changed_cb), desktop);
@@ -1114,6 +1367,8 @@ xfce_desktop_unrealize(GtkWidget *widget)
     
     g_return_if_fail(XFCE_IS_DESKTOP(desktop));
 
+    xfce_desktop_stop_fades(desktop, NULL);
+
     /* disconnect all the xfconf settings to this desktop */
     xfconf_g_property_unbind_all(G_OBJECT(desktop));
 
@@ -1163,6 +1418,9 @@ xfce_desktop_unrealize(GtkWidget *widget)
         g_object_unref(G_OBJECT(desktop->priv->bg_pixmap));
         desktop->priv->bg_pixmap = NULL;
     }
+#ifdef ENABLE_DESKTOP_ICONS
+    xfce_desktop_update_icon_view_background(desktop);
+#endif
     
     gtk_window_set_icon(GTK_WINDOW(widget), NULL);
 
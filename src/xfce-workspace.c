@@ -666,6 +666,16 @@ xfce_workspace_connect_backdrop_settings(XfceWorkspace *workspace,
     xfconf_g_property_bind(channel, buf, G_TYPE_BOOLEAN,
                            G_OBJECT(backdrop), "backdrop-cycle-random-order");
 
+    buf[pp_len] = 0;
+    g_strlcat(buf, "backdrop-cycle-shuffle-seed", sizeof(buf));
+    xfconf_g_property_bind(channel, buf, G_TYPE_UINT,
+                           G_OBJECT(backdrop), "backdrop-cycle-shuffle-seed");
+
+    buf[pp_len] = 0;
+    g_strlcat(buf, "backdrop-cycle-shuffle-position", sizeof(buf));
+    xfconf_g_property_bind(channel, buf, G_TYPE_UINT,
+                           G_OBJECT(backdrop), "backdrop-cycle-shuffle-position");
+
     buf[pp_len] = 0;
     g_strlcat(buf, "last-image", sizeof(buf));
     if(!xfconf_channel_has_property(channel, buf)) {
@@ -66,6 +66,7 @@
 #include "xfdesktop-file-icon-manager.h"
 #include "xfdesktop-file-utils.h"
 #include "xfdesktop-file-manager-proxy.h"
+#include "xfdesktop-icon-position-db.h"
 #include "xfdesktop-icon-view.h"
 #include "xfdesktop-regular-file-icon.h"
 #include "xfdesktop-special-file-icon.h"
@@ -79,6 +80,21 @@
 #define SAVE_DELAY  1000
 #define BORDER         8
 
+/* how long loading the desktop folder may keep the main loop busy in one
+ * go, about half a frame at 60 fps */
+#define LOAD_FRAME_BUDGET  8000  /* usec */
+/* the number of files asked for per enumerator round trip starts at the
+ * minimum and grows as long as a batch fits in LOAD_FRAME_BUDGET */
+#define ENUMERATE_BATCH_MIN    32
+#define ENUMERATE_BATCH_MAX  1024
+/* the number of queued icons handed to the icon view at once */
+#define PENDING_ICONS_BATCH    32
+
+/* file monitor events for the same file within this many ms are merged */
+#define FILE_EVENT_DELAY        100
+/* the number of file info queries running in parallel */
+#define FILE_EVENT_MAX_QUERIES   16
+
 typedef enum
 {
     PROP0 = 0,
@@ -117,6 +133,8 @@ struct _XfdesktopFileIconManagerPrivate
     XfdesktopFileIcon *desktop_icon;
     GFileMonitor *monitor;
     GFileEnumerator *enumerator;
+    GCancellable *enumerate_cancellable;
+    gint enumerate_batch_size;
 
     GVolumeMonitor *volume_monitor;
 
@@ -136,9 +154,23 @@ struct _XfdesktopFileIconManagerPrivate
     gboolean show_hidden_files;
     
     guint save_icons_id;
+
+    /* the saved icon positions for the workarea size in
+     * position_db_relpath */
+    XfdesktopIconPositionDb *position_db;
+    gchar *position_db_relpath;
     
     GQueue *pending_icons;
     guint pending_icons_id;
+
+    /* file monitor events waiting for their file info: GFile -> event */
+    GHashTable *file_events;
+    GQueue file_events_waiting;
+    GQueue file_events_ready;
+    guint file_events_n_querying;
+    guint file_events_timeout_id;
+    guint file_events_apply_id;
+    GCancellable *file_events_cancellable;
     
     GtkTargetList *drag_targets;
     GtkTargetList *drop_targets;
@@ -200,6 +232,7 @@ static gboolean xfdesktop_file_icon_manager_check_create_desktop_folder(GFile *f
 static void xfdesktop_file_icon_manager_load_desktop_folder(XfdesktopFileIconManager *fmanager);
 static void xfdesktop_file_icon_manager_load_removable_media(XfdesktopFileIconManager *fmanager);
 static void xfdesktop_file_icon_manager_remove_removable_media(XfdesktopFileIconManager *fmanager);
+static void xfdesktop_file_icon_manager_clear_file_events(XfdesktopFileIconManager *fmanager);
 
 
 static void xfdesktop_file_icon_manager_set_show_special_file(XfdesktopFileIconManager *manager,
@@ -527,6 +560,9 @@ xfdesktop_file_icon_manager_finalize(GObject *obj)
     if(fmanager->priv->volume_monitor != NULL)
         g_object_unref(fmanager->priv->volume_monitor);
 
+    xfdesktop_icon_position_db_free(fmanager->priv->position_db);
+    g_free(fmanager->priv->position_db_relpath);
+
     G_OBJECT_CLASS(xfdesktop_file_icon_manager_parent_class)->finalize(obj);
 }
 
@@ -1914,25 +1950,136 @@ xfdesktop_file_icon_manager_populate_context_menu(XfceDesktop *desktop,
     /* don't free |selected|.  the menu deactivated handler does that */
 }
 
+/* Fills in the name of the icon position file for the current workarea
+ * size, @suffix being the extension.  This runs for every position lookup,
+ * so it goes by the size the icon view has cached. */
+static void
+xfdesktop_file_icon_manager_get_positions_relpath(XfdesktopFileIconManager *fmanager,
+                                                  const gchar *suffix,
+                                                  gchar *relpath)
+{
+    gint width = 0, height = 0;
+
+    xfdesktop_icon_view_get_workarea_size(fmanager->priv->icon_view,
+                                          &width, &height);
+
+    g_snprintf(relpath, PATH_MAX, "xfce4/desktop/icons.screen%d-%dx%d.%s",
+               gdk_screen_get_number(fmanager->priv->gscreen),
+               width,
+               height,
+               suffix);
+}
+
+/* Fills a new position database from the rc file older versions saved the
+ * positions in */
+static void
+xfdesktop_file_icon_manager_import_rc_positions(XfdesktopFileIconManager *fmanager,
+                                                XfdesktopIconPositionDb *db)
+{
+    gchar relpath[PATH_MAX];
+    gchar *filename, **groups;
+    XfceRc *rcfile;
+    gint i, row, col;
+
+    xfdesktop_file_icon_manager_get_positions_relpath(fmanager, "rc", relpath);
+    filename = xfce_resource_lookup(XFCE_RESOURCE_CONFIG, relpath);
+
+    /* Check if we have to migrate from the old file format */
+    if(filename == NULL) {
+        g_snprintf(relpath, PATH_MAX, "xfce4/desktop/icons.screen%d.rc",
+                   gdk_screen_get_number(fmanager->priv->gscreen));
+        filename = xfce_resource_lookup(XFCE_RESOURCE_CONFIG, relpath);
+    }
+
+    if(filename == NULL)
+        return;
+
+    XF_DEBUG("importing icon positions from: %s", filename);
+
+    rcfile = xfce_rc_simple_open(filename, TRUE);
+    g_free(filename);
+    if(!rcfile)
+        return;
+
+    /* Newer versions use the identifier rather than the icon label when
+     * possible */
+    xfdesktop_icon_position_db_set_keyed_by_identifier(db,
+                                                       xfce_rc_has_group(rcfile,
+                                                                         XFDESKTOP_RC_VERSION_STAMP));
+
+    groups = xfce_rc_get_groups(rcfile);
+    for(i = 0; groups && groups[i]; i++) {
+        xfce_rc_set_group(rcfile, groups[i]);
+        row = xfce_rc_read_int_entry(rcfile, "row", -1);
+        col = xfce_rc_read_int_entry(rcfile, "col", -1);
+        if(row >= 0 && col >= 0)
+            xfdesktop_icon_position_db_set(db, groups[i], row, col);
+    }
+
+    g_strfreev(groups);
+    xfce_rc_close(rcfile);
+}
+
+/* Returns the position database for the current workarea size, opening
+ * it if the workarea changed size since the last call */
+static XfdesktopIconPositionDb *
+xfdesktop_file_icon_manager_get_position_db(XfdesktopFileIconManager *fmanager)
+{
+    gchar relpath[PATH_MAX], *filename;
+
+    xfdesktop_file_icon_manager_get_positions_relpath(fmanager, "db", relpath);
+
+    if(fmanager->priv->position_db_relpath
+       && !strcmp(relpath, fmanager->priv->position_db_relpath))
+    {
+        return fmanager->priv->position_db;
+    }
+
+    xfdesktop_icon_position_db_free(fmanager->priv->position_db);
+    fmanager->priv->position_db = NULL;
+    g_free(fmanager->priv->position_db_relpath);
+    fmanager->priv->position_db_relpath = g_strdup(relpath);
+
+    filename = xfce_resource_save_location(XFCE_RESOURCE_CONFIG, relpath, TRUE);
+    if(!filename) {
+        g_warning("Unable to determine location of icon position cache file.  " \
+                  "Icon positions will not be saved.");
+        return NULL;
+    }
+
+    XF_DEBUG("using icon positions in: %s", filename);
+
+    fmanager->priv->position_db = xfdesktop_icon_position_db_open(filename);
+    g_free(filename);
+
+    if(xfdesktop_icon_position_db_is_new(fmanager->priv->position_db)) {
+        xfdesktop_file_icon_manager_import_rc_positions(fmanager,
+                                                        fmanager->priv->position_db);
+    }
+
+    return fmanager->priv->position_db;
+}
+
 static void
 file_icon_hash_write_icons(gpointer key,
                            gpointer value,
                            gpointer data)
 {
-    XfceRc *rcfile = data;
+    XfdesktopIconPositionDb *db = data;
     XfdesktopIcon *icon = value;
     gint16 row, col;
     gchar *identifier = xfdesktop_icon_get_identifier(icon);
+    const gchar *icon_name;
 
     if(xfdesktop_icon_get_position(icon, &row, &col)) {
         /* Attempt to use the identifier, fall back to using the labels. */
         if(identifier)
-            xfce_rc_set_group(rcfile, identifier);
+            icon_name = identifier;
         else
-            xfce_rc_set_group(rcfile, xfdesktop_icon_peek_label(icon));
+            icon_name = xfdesktop_icon_peek_label(icon);
 
-        xfce_rc_write_int_entry(rcfile, "row", row);
-        xfce_rc_write_int_entry(rcfile, "col", col);
+        if(icon_name)
+            xfdesktop_icon_position_db_set(db, icon_name, row, col);
     }
 
     if(identifier)
@@ -1943,68 +2090,34 @@ static gboolean
 xfdesktop_file_icon_manager_save_icons(gpointer user_data)
 {
     XfdesktopFileIconManager *fmanager = XFDESKTOP_FILE_ICON_MANAGER(user_data);
-    gchar relpath[PATH_MAX], *tmppath, *path;
-    XfceRc *rcfile;
-    gint x = 0, y = 0, width = 0, height = 0;
+    XfdesktopIconPositionDb *db;
     
     fmanager->priv->save_icons_id = 0;
 
-    xfdesktop_get_workarea_single(fmanager->priv->icon_view,
-                                  0,
-                                  &x,
-                                  &y,
-                                  &width,
-                                  &height);
-
-    g_snprintf(relpath, PATH_MAX, "xfce4/desktop/icons.screen%d-%dx%d.rc",
-               gdk_screen_get_number(fmanager->priv->gscreen),
-               width,
-               height);
-
-    path = xfce_resource_save_location(XFCE_RESOURCE_CONFIG, relpath, TRUE);
-    if(!path)
+    db = xfdesktop_file_icon_manager_get_position_db(fmanager);
+    if(!db)
         return FALSE;
 
-    XF_DEBUG("saving to: %s", path);
-
-    tmppath = g_strconcat(path, ".new", NULL);
-    
-    rcfile = xfce_rc_simple_open(tmppath, FALSE);
-    if(!rcfile) {
-        g_warning("Unable to determine location of icon position cache file.  " \
-                  "Icon positions will not be saved.");
-        g_free(path);
-        g_free(tmppath);
-        return FALSE;
+    /* only the icons that moved get written, unless the whole file is
+     * about to be rewritten anyway; then start over so the positions of
+     * icons that are gone are dropped */
+    if(xfdesktop_icon_position_db_needs_compaction(db)
+       || !xfdesktop_icon_position_db_get_keyed_by_identifier(db))
+    {
+        xfdesktop_icon_position_db_clear(db);
+        xfdesktop_icon_position_db_set_keyed_by_identifier(db, TRUE);
     }
 
-    xfce_rc_set_group(rcfile, XFDESKTOP_RC_VERSION_STAMP);
-    xfce_rc_write_bool_entry(rcfile, "4.10.3+", TRUE);
-
     g_hash_table_foreach(fmanager->priv->icons,
-                         file_icon_hash_write_icons, rcfile);
+                         file_icon_hash_write_icons, db);
     if(fmanager->priv->show_removable_media) {
         g_hash_table_foreach(fmanager->priv->removable_icons,
-                             file_icon_hash_write_icons, rcfile);
+                             file_icon_hash_write_icons, db);
     }
     g_hash_table_foreach(fmanager->priv->special_icons,
-                         file_icon_hash_write_icons, rcfile);
+                         file_icon_hash_write_icons, db);
     
-    xfce_rc_flush(rcfile);
-    xfce_rc_close(rcfile);
-
-    if(g_file_test(tmppath, G_FILE_TEST_EXISTS)) {
-        if(rename(tmppath, path)) {
-            g_warning("Unable to rename temp file to %s: %s", path,
-                      strerror(errno));
-            unlink(tmppath);
-        }
-    } else {
-        XF_DEBUG("didn't write anything in the RC file, desktop is probably empty");
-    }
-    
-    g_free(path);
-    g_free(tmppath);
+    xfdesktop_icon_position_db_save(db);
     
     return FALSE;
 }
@@ -2042,59 +2155,26 @@ xfdesktop_file_icon_manager_get_cached_icon_position(XfdesktopFileIconManager *f
                                                      gint16 *row,
                                                      gint16 *col)
 {
-    gchar relpath[PATH_MAX];
-    gchar *filename = NULL;
-    gboolean ret = FALSE;
-    gint x = 0, y = 0, width = 0, height = 0;
+    XfdesktopIconPositionDb *db;
+    const gchar *icon_name;
 
     if(!fmanager || !fmanager->priv)
         return FALSE;
 
-    xfdesktop_get_workarea_single(fmanager->priv->icon_view,
-                                  0,
-                                  &x,
-                                  &y,
-                                  &width,
-                                  &height);
-    
-    g_snprintf(relpath, PATH_MAX, "xfce4/desktop/icons.screen%d-%dx%d.rc",
-               gdk_screen_get_number(fmanager->priv->gscreen),
-               width,
-               height);
-
-    filename = xfce_resource_lookup(XFCE_RESOURCE_CONFIG, relpath);
+    /* only opens the file if the workarea changed size */
+    db = xfdesktop_file_icon_manager_get_position_db(fmanager);
+    if(!db)
+        return FALSE;
 
-    /* Check if we have to migrate from the old file format */
-    if(filename == NULL) {
-        g_snprintf(relpath, PATH_MAX, "xfce4/desktop/icons.screen%d.rc",
-        gdk_screen_get_number(fmanager->priv->gscreen));
-        filename = xfce_resource_lookup(XFCE_RESOURCE_CONFIG, relpath);
-    }
+    if(xfdesktop_icon_position_db_get_keyed_by_identifier(db) && identifier)
+        icon_name = identifier;
+    else
+        icon_name = name;
 
-    if(filename != NULL) {
-        XfceRc *rcfile;
-        const gchar *icon_name;
-        rcfile = xfce_rc_simple_open(filename, TRUE);
+    if(!icon_name)
+        return FALSE;
 
-        /* Newer versions use the identifier rather than the icon label when
-         * possible */
-        if(xfce_rc_has_group(rcfile, XFDESKTOP_RC_VERSION_STAMP) && identifier)
-            icon_name = identifier;
-        else
-            icon_name = name;
-
-        if(xfce_rc_has_group(rcfile, icon_name)) {
-            xfce_rc_set_group(rcfile, icon_name);
-            *row = xfce_rc_read_int_entry(rcfile, "row", -1);
-            *col = xfce_rc_read_int_entry(rcfile, "col", -1);
-            if(*row >= 0 && *col >= 0)
-                ret = TRUE;
-        }
-        xfce_rc_close(rcfile);
-        g_free(filename);
-    }
-    
-    return ret;
+    return xfdesktop_icon_position_db_lookup(db, icon_name, row, col);
 }
 
 
@@ -2135,37 +2215,74 @@ xfdesktop_file_icon_manager_queue_thumbnail(XfdesktopFileIconManager *fmanager,
 }
 
 static void
-add_icon_to_iconview(XfdesktopFileIconManager *fmanager,
-                     XfdesktopIcon *icon)
+add_icons_to_iconview(XfdesktopFileIconManager *fmanager,
+                      XfdesktopIcon **icons,
+                      guint n_icons)
 {
-    /* Pay attention to position changes and add the icon to the icon view */
-    g_signal_connect(G_OBJECT(icon), "position-changed",
-                     G_CALLBACK(xfdesktop_file_icon_position_changed),
-                     fmanager);
+    guint i;
 
-    /* Tell the icon view about the icon */
-    xfdesktop_icon_view_add_item(fmanager->priv->icon_view,
-                                 XFDESKTOP_ICON(icon));
+    /* Pay attention to position changes */
+    for(i = 0; i < n_icons; i++) {
+        g_signal_connect(G_OBJECT(icons[i]), "position-changed",
+                         G_CALLBACK(xfdesktop_file_icon_position_changed),
+                         fmanager);
 
 #if defined(DEBUG) && DEBUG > 0
-    _alive_icon_list = g_list_prepend(_alive_icon_list, icon);
-    g_object_weak_ref(G_OBJECT(icon), _icon_notify_destroy, NULL);
+        _alive_icon_list = g_list_prepend(_alive_icon_list, icons[i]);
+        g_object_weak_ref(G_OBJECT(icons[i]), _icon_notify_destroy, NULL);
 #endif
+    }
+
+    /* Tell the icon view about the icons */
+    xfdesktop_icon_view_add_items(fmanager->priv->icon_view, icons, n_icons);
+}
+
+static void
+add_icon_to_iconview(XfdesktopFileIconManager *fmanager,
+                     XfdesktopIcon *icon)
+{
+    add_icons_to_iconview(fmanager, &icon, 1);
 }
 
-/* Adds a single icon to the icon view, popping from the top of the stack.
- * Will continue to run until it runs out of icons to add at which point
- * it will free the queue and return FALSE */
+/* Adds icons to the icon view, popping from the top of the stack, for as
+ * long as it fits in LOAD_FRAME_BUDGET.  They are handed over in batches
+ * of PENDING_ICONS_BATCH so the icon view can place them in one go.  Will
+ * continue to run until it runs out of icons to add at which point it will
+ * free the queue and return FALSE */
 static gboolean
 process_icon_from_queue(gpointer user_data)
 {
     XfdesktopFileIconManager *fmanager;
     XfdesktopFileIcon *icon;
+    XfdesktopIcon *batch[PENDING_ICONS_BATCH];
+    guint n_batch;
+    gint64 deadline;
 
     g_return_val_if_fail(XFDESKTOP_IS_FILE_ICON_MANAGER(user_data), FALSE);
 
     fmanager = XFDESKTOP_FILE_ICON_MANAGER(user_data);
 
+    deadline = g_get_monotonic_time() + LOAD_FRAME_BUDGET;
+
+    while(!g_queue_is_empty(fmanager->priv->pending_icons)
+          && g_get_monotonic_time() < deadline)
+    {
+        n_batch = 0;
+        while(n_batch < PENDING_ICONS_BATCH
+              && !g_queue_is_empty(fmanager->priv->pending_icons))
+        {
+            icon = g_queue_pop_head(fmanager->priv->pending_icons);
+
+            /* skip bad icons */
+            if(icon == NULL || !XFDESKTOP_IS_FILE_ICON(icon))
+                continue;
+
+            batch[n_batch++] = XFDESKTOP_ICON(icon);
+        }
+
+        add_icons_to_iconview(fmanager, batch, n_batch);
+    }
+
     /* Free our queue and return FALSE when we run out of items */
     if(g_queue_is_empty(fmanager->priv->pending_icons)) {
         g_queue_free(fmanager->priv->pending_icons);
@@ -2174,14 +2291,6 @@ process_icon_from_queue(gpointer user_data)
         return FALSE;
     }
 
-    icon = g_queue_pop_head(fmanager->priv->pending_icons);
-
-    /* skip bad icons */
-    if(icon == NULL || !XFDESKTOP_IS_FILE_ICON(icon))
-        return TRUE;
-
-    add_icon_to_iconview(fmanager, XFDESKTOP_ICON(icon));
-
     return TRUE;
 }
 
@@ -2279,14 +2388,13 @@ xfdesktop_file_icon_manager_add_icon(XfdesktopFileIconManager *fmanager,
         XF_DEBUG("icon '%s' didn't have a previous position", name);
     }
 
-    if(fmanager->priv->pending_icons_id != 0)
-        g_source_remove(fmanager->priv->pending_icons_id);
-
     /* While xfdesktop is idle we'll add icons to the icon view */
-    fmanager->priv->pending_icons_id = g_idle_add_full(G_PRIORITY_LOW,
-                                                       process_icon_from_queue,
-                                                       fmanager,
-                                                       NULL);
+    if(fmanager->priv->pending_icons_id == 0) {
+        fmanager->priv->pending_icons_id = g_idle_add_full(G_PRIORITY_LOW,
+                                                           process_icon_from_queue,
+                                                           fmanager,
+                                                           NULL);
+    }
 
     if(identifier)
         g_free(identifier);
@@ -2477,26 +2585,56 @@ xfdesktop_file_icon_manager_add_special_file_icon(XfdesktopFileIconManager *fman
     return XFDESKTOP_FILE_ICON(icon);
 }
 
-static gboolean
-xfdesktop_remove_icons_ht(gpointer key,
-                          gpointer value,
-                          gpointer user_data)
+/* Takes the special icons off the desktop and forgets about them */
+static void
+xfdesktop_file_icon_manager_remove_special_icons(XfdesktopFileIconManager *fmanager)
 {
-    XfdesktopFileIconManager *fmanager = XFDESKTOP_FILE_ICON_MANAGER(user_data);
-    XfdesktopIcon *icon = XFDESKTOP_ICON(value);
-    GList *item = NULL;
+    XfdesktopIcon *icons[XFDESKTOP_SPECIAL_FILE_ICON_TRASH+1];
+    guint n_icons = 0;
+    gint i;
 
-    /* find out if the icon was pending creation */
-    if(fmanager->priv->pending_icons)
-        item = g_queue_find(fmanager->priv->pending_icons, icon);
+    for(i = 0; i <= XFDESKTOP_SPECIAL_FILE_ICON_TRASH; ++i) {
+        XfdesktopIcon *icon = g_hash_table_lookup(fmanager->priv->special_icons,
+                                                  GINT_TO_POINTER(i));
+        if(icon)
+            icons[n_icons++] = icon;
+    }
 
-    /* Remove the icon if it was in the icon view */
-    if(item == NULL) {
-        xfdesktop_icon_view_remove_item(fmanager->priv->icon_view,
-                                        XFDESKTOP_ICON(value));
+    xfdesktop_icon_view_remove_items(fmanager->priv->icon_view, icons, n_icons);
+    g_hash_table_remove_all(fmanager->priv->special_icons);
+}
+
+/* Takes the regular file icons off the desktop and forgets about them */
+static void
+xfdesktop_file_icon_manager_remove_regular_icons(XfdesktopFileIconManager *fmanager)
+{
+    GPtrArray *icons;
+    GHashTableIter iter;
+    gpointer value;
+
+    if(!fmanager->priv->icons)
+        return;
+
+    icons = g_ptr_array_sized_new(g_hash_table_size(fmanager->priv->icons));
+
+    g_hash_table_iter_init(&iter, fmanager->priv->icons);
+    while(g_hash_table_iter_next(&iter, NULL, &value)) {
+        /* icons still pending creation aren't in the icon view */
+        if(fmanager->priv->pending_icons
+           && g_queue_find(fmanager->priv->pending_icons, value))
+        {
+            continue;
+        }
+
+        g_ptr_array_add(icons, value);
     }
 
-    return TRUE;
+    xfdesktop_icon_view_remove_items(fmanager->priv->icon_view,
+                                     (XfdesktopIcon **)icons->pdata,
+                                     icons->len);
+    g_ptr_array_free(icons, TRUE);
+
+    g_hash_table_remove_all(fmanager->priv->icons);
 }
 
 static void
@@ -2511,27 +2649,18 @@ xfdesktop_file_icon_manager_refresh_icons(XfdesktopFileIconManager *fmanager)
         xfdesktop_file_icon_manager_save_icons(fmanager);
     }
     
+    /* ditch file monitor events that haven't been applied yet */
+    xfdesktop_file_icon_manager_clear_file_events(fmanager);
+
     /* ditch removable media */
     if(fmanager->priv->show_removable_media)
         xfdesktop_file_icon_manager_remove_removable_media(fmanager);
     
     /* ditch special icons */
-    for(i = 0; i <= XFDESKTOP_SPECIAL_FILE_ICON_TRASH; ++i) {
-        XfdesktopIcon *icon = g_hash_table_lookup(fmanager->priv->special_icons,
-                                                  GINT_TO_POINTER(i));
-        if(icon) {
-            xfdesktop_icon_view_remove_item(fmanager->priv->icon_view, icon);
-            g_hash_table_remove(fmanager->priv->special_icons,
-                                GINT_TO_POINTER(i));
-        }
-    }
+    xfdesktop_file_icon_manager_remove_special_icons(fmanager);
 
     /* ditch normal icons */
-    if(fmanager->priv->icons) {
-        g_hash_table_foreach_remove(fmanager->priv->icons,
-                                    (GHRFunc)xfdesktop_remove_icons_ht,
-                                    fmanager);
-    }
+    xfdesktop_file_icon_manager_remove_regular_icons(fmanager);
     
 #if defined(DEBUG) && DEBUG > 0
     g_assert(_xfdesktop_icon_view_n_items(fmanager->priv->icon_view) == 0);
@@ -2643,6 +2772,397 @@ xfdesktop_file_icon_manager_key_press(GtkWidget *widget,
     return FALSE;
 }
 
+typedef enum
+{
+    FILE_EVENT_WAITING = 0,
+    FILE_EVENT_QUERYING,
+    FILE_EVENT_READY,
+} XfdesktopFileEventState;
+
+/* A file the monitor told us about that still needs its GFileInfo looked
+ * up.  All events for the same file are folded into one of these. */
+typedef struct
+{
+    GFile *file;
+    XfdesktopFileEventState state;
+    /* where a moved file should end up, -1 if it should just go into the
+     * next free spot */
+    gint16 row;
+    gint16 col;
+    /* the query result, NULL if the file is gone */
+    GFileInfo *info;
+    /* another event came in while the query was running, so the result
+     * may be outdated */
+    gboolean stale;
+    /* the file was deleted while the query was running */
+    gboolean discard;
+    /* only refresh an icon that's already there; nothing is added, and a
+     * failed query doesn't take the icon away */
+    gboolean update_only;
+    /* the icon of the file this one was moved from.  it stays where it is
+     * until this event is applied, so nothing else gets its spot */
+    XfdesktopFileIcon *replaces;
+} XfdesktopFileEvent;
+
+/* What a running query needs to find its way back */
+typedef struct
+{
+    XfdesktopFileIconManager *fmanager;
+    GCancellable *cancellable;
+} XfdesktopFileEventQuery;
+
+static void xfdesktop_file_icon_manager_start_file_queries(XfdesktopFileIconManager *fmanager);
+
+static void
+xfdesktop_file_event_free(XfdesktopFileEvent *event)
+{
+    g_object_unref(event->file);
+    if(event->info)
+        g_object_unref(event->info);
+    if(event->replaces)
+        g_object_unref(event->replaces);
+    g_slice_free(XfdesktopFileEvent, event);
+}
+
+/* Takes the icon @event was holding a spot for off the desktop */
+static void
+xfdesktop_file_icon_manager_remove_replaced_icon(XfdesktopFileIconManager *fmanager,
+                                                 XfdesktopFileEvent *event)
+{
+    XfdesktopFileIcon *icon = event->replaces;
+
+    if(!icon)
+        return;
+
+    event->replaces = NULL;
+
+    /* unless another event took care of it already */
+    if(g_hash_table_lookup(fmanager->priv->icons,
+                           xfdesktop_file_icon_peek_file(icon)) == icon)
+    {
+        xfdesktop_file_icon_manager_remove_icon(fmanager, icon);
+    }
+
+    g_object_unref(icon);
+}
+
+/* Forgets about all monitor events that haven't been applied yet */
+static void
+xfdesktop_file_icon_manager_clear_file_events(XfdesktopFileIconManager *fmanager)
+{
+    if(fmanager->priv->file_events_timeout_id != 0) {
+        g_source_remove(fmanager->priv->file_events_timeout_id);
+        fmanager->priv->file_events_timeout_id = 0;
+    }
+
+    if(fmanager->priv->file_events_apply_id != 0) {
+        g_source_remove(fmanager->priv->file_events_apply_id);
+        fmanager->priv->file_events_apply_id = 0;
+    }
+
+    /* the running queries see they were cancelled and don't look at the
+     * events anymore */
+    if(fmanager->priv->file_events_cancellable) {
+        g_cancellable_cancel(fmanager->priv->file_events_cancellable);
+        g_object_unref(fmanager->priv->file_events_cancellable);
+        fmanager->priv->file_events_cancellable = NULL;
+    }
+    fmanager->priv->file_events_n_querying = 0;
+
+    g_queue_clear(&fmanager->priv->file_events_waiting);
+    g_queue_clear(&fmanager->priv->file_events_ready);
+
+    if(fmanager->priv->file_events) {
+        g_hash_table_destroy(fmanager->priv->file_events);
+        fmanager->priv->file_events = NULL;
+    }
+}
+
+/* Applies the query results, for as long as it fits in LOAD_FRAME_BUDGET */
+static gboolean
+xfdesktop_file_icon_manager_apply_file_events(gpointer user_data)
+{
+    XfdesktopFileIconManager *fmanager = XFDESKTOP_FILE_ICON_MANAGER(user_data);
+    XfdesktopFileEvent *event;
+    XfdesktopFileIcon *icon;
+    gint64 deadline;
+
+    deadline = g_get_monotonic_time() + LOAD_FRAME_BUDGET;
+
+    while((event = g_queue_pop_head(&fmanager->priv->file_events_ready))) {
+        /* a moved file's old icon goes right before the new one shows up
+         * in its place */
+        xfdesktop_file_icon_manager_remove_replaced_icon(fmanager, event);
+
+        icon = g_hash_table_lookup(fmanager->priv->icons, event->file);
+
+        if(!event->info) {
+            /* Remove the icon as it doesn't seem to exist, the monitor
+             * tells us when a file is really gone */
+            if(icon && !event->update_only)
+                xfdesktop_file_icon_manager_remove_icon(fmanager, icon);
+        } else if(icon) {
+            /* update the icon if the file still exists */
+            xfdesktop_file_icon_update_file_info(icon, event->info);
+        } else if(event->update_only) {
+            /* the icon went away in the meantime */
+        } else if(event->row >= 0 && event->col >= 0) {
+            /* Add the icon adding the row/col info */
+            icon = xfdesktop_file_icon_manager_add_regular_icon(fmanager,
+                                                                event->file,
+                                                                event->info,
+                                                                event->row,
+                                                                event->col,
+                                                                FALSE);
+            if(icon)
+                xfdesktop_file_icon_position_changed(icon, fmanager);
+        } else {
+            /* new icons go through the pending queue, which hands them
+             * to the icon view in batches */
+            xfdesktop_file_icon_manager_add_regular_icon(fmanager,
+                                                         event->file,
+                                                         event->info,
+                                                         -1, -1,
+                                                         TRUE);
+        }
+
+        /* frees the event */
+        g_hash_table_remove(fmanager->priv->file_events, event->file);
+
+        if(g_get_monotonic_time() >= deadline)
+            return TRUE;
+    }
+
+    fmanager->priv->file_events_apply_id = 0;
+
+    return FALSE;
+}
+
+static void
+xfdesktop_file_icon_manager_file_info_ready(GObject *source,
+                                            GAsyncResult *result,
+                                            gpointer user_data)
+{
+    XfdesktopFileEventQuery *query = user_data;
+    XfdesktopFileIconManager *fmanager = query->fmanager;
+    XfdesktopFileEvent *event;
+    GFileInfo *info;
+
+    info = g_file_query_info_finish(G_FILE(source), result, NULL);
+
+    /* the events were thrown away, even if the query made it */
+    if(g_cancellable_is_cancelled(query->cancellable)) {
+        if(info)
+            g_object_unref(info);
+        g_object_unref(query->cancellable);
+        g_object_unref(fmanager);
+        g_slice_free(XfdesktopFileEventQuery, query);
+        return;
+    }
+
+    g_object_unref(query->cancellable);
+    g_slice_free(XfdesktopFileEventQuery, query);
+
+    fmanager->priv->file_events_n_querying--;
+
+    event = g_hash_table_lookup(fmanager->priv->file_events, source);
+    if(!event || event->state != FILE_EVENT_QUERYING) {
+        if(info)
+            g_object_unref(info);
+    } else if(event->discard) {
+        if(info)
+            g_object_unref(info);
+        g_hash_table_remove(fmanager->priv->file_events, source);
+    } else if(event->stale) {
+        /* look it up again, the file changed since the query started */
+        if(info)
+            g_object_unref(info);
+        event->stale = FALSE;
+        event->state = FILE_EVENT_WAITING;
+        g_queue_push_tail(&fmanager->priv->file_events_waiting, event);
+    } else {
+        event->info = info;
+        event->state = FILE_EVENT_READY;
+        g_queue_push_tail(&fmanager->priv->file_events_ready, event);
+
+        if(fmanager->priv->file_events_apply_id == 0) {
+            fmanager->priv->file_events_apply_id = g_idle_add(xfdesktop_file_icon_manager_apply_file_events,
+                                                              fmanager);
+        }
+    }
+
+    /* keep the queries going, unless more events are still being
+     * collected */
+    if(fmanager->priv->file_events_timeout_id == 0)
+        xfdesktop_file_icon_manager_start_file_queries(fmanager);
+
+    g_object_unref(fmanager);
+}
+
+/* Starts queries for the waiting events, at most FILE_EVENT_MAX_QUERIES
+ * at a time */
+static void
+xfdesktop_file_icon_manager_start_file_queries(XfdesktopFileIconManager *fmanager)
+{
+    XfdesktopFileEvent *event;
+    XfdesktopFileEventQuery *query;
+
+    if(!fmanager->priv->file_events_cancellable)
+        fmanager->priv->file_events_cancellable = g_cancellable_new();
+
+    while(fmanager->priv->file_events_n_querying < FILE_EVENT_MAX_QUERIES
+          && (event = g_queue_pop_head(&fmanager->priv->file_events_waiting)))
+    {
+        event->state = FILE_EVENT_QUERYING;
+        fmanager->priv->file_events_n_querying++;
+
+        query = g_slice_new(XfdesktopFileEventQuery);
+        query->fmanager = g_object_ref(fmanager);
+        query->cancellable = g_object_ref(fmanager->priv->file_events_cancellable);
+
+        g_file_query_info_async(event->file,
+                                XFDESKTOP_FILE_INFO_NAMESPACE,
+                                G_FILE_QUERY_INFO_NONE,
+                                G_PRIORITY_DEFAULT,
+                                query->cancellable,
+                                xfdesktop_file_icon_manager_file_info_ready,
+                                query);
+    }
+}
+
+static gboolean
+xfdesktop_file_icon_manager_file_events_timeout(gpointer user_data)
+{
+    XfdesktopFileIconManager *fmanager = XFDESKTOP_FILE_ICON_MANAGER(user_data);
+
+    fmanager->priv->file_events_timeout_id = 0;
+    xfdesktop_file_icon_manager_start_file_queries(fmanager);
+
+    return FALSE;
+}
+
+/* Schedules a look up of @file's info.  Events for the same file that
+ * arrive within FILE_EVENT_DELAY are merged into one query.  A @row and
+ * @col of -1 leave an earlier position hint alone.  @update_only is for
+ * refreshing the icons we have, it's dropped as soon as a monitor event
+ * for the same file comes in. */
+static XfdesktopFileEvent *
+xfdesktop_file_icon_manager_queue_file_event(XfdesktopFileIconManager *fmanager,
+                                             GFile *file,
+                                             gint16 row,
+                                             gint16 col,
+                                             gboolean update_only)
+{
+    XfdesktopFileEvent *event;
+
+    if(!fmanager->priv->file_events) {
+        fmanager->priv->file_events = g_hash_table_new_full(g_file_hash,
+                                                            (GEqualFunc)g_file_equal,
+                                                            NULL,
+                                                            (GDestroyNotify)xfdesktop_file_event_free);
+    }
+
+    event = g_hash_table_lookup(fmanager->priv->file_events, file);
+    if(!event) {
+        event = g_slice_new0(XfdesktopFileEvent);
+        event->file = g_object_ref(file);
+        event->row = event->col = -1;
+        event->state = FILE_EVENT_WAITING;
+        event->update_only = update_only;
+        g_hash_table_insert(fmanager->priv->file_events, event->file, event);
+        g_queue_push_tail(&fmanager->priv->file_events_waiting, event);
+    } else if(event->state == FILE_EVENT_QUERYING) {
+        event->stale = TRUE;
+        event->discard = FALSE;
+    } else if(event->state == FILE_EVENT_READY) {
+        /* the result is outdated already */
+        g_queue_remove(&fmanager->priv->file_events_ready, event);
+        if(event->info) {
+            g_object_unref(event->info);
+            event->info = NULL;
+        }
+        event->state = FILE_EVENT_WAITING;
+        g_queue_push_tail(&fmanager->priv->file_events_waiting, event);
+    }
+
+    if(!update_only)
+        event->update_only = FALSE;
+
+    if(row >= 0 && col >= 0) {
+        event->row = row;
+        event->col = col;
+    }
+
+    if(fmanager->priv->file_events_timeout_id == 0) {
+        fmanager->priv->file_events_timeout_id = g_timeout_add(FILE_EVENT_DELAY,
+                                                               xfdesktop_file_icon_manager_file_events_timeout,
+                                                               fmanager);
+    }
+
+    return event;
+}
+
+/* Queues @file, which @icon's file was moved to.  @icon stays on the
+ * desktop until the new icon can take over its spot, and the look up
+ * doesn't wait for FILE_EVENT_DELAY so that's quick. */
+static void
+xfdesktop_file_icon_manager_queue_move_event(XfdesktopFileIconManager *fmanager,
+                                             GFile *file,
+                                             XfdesktopFileIcon *icon,
+                                             gint16 row,
+                                             gint16 col)
+{
+    XfdesktopFileEvent *event;
+
+    event = xfdesktop_file_icon_manager_queue_file_event(fmanager, file,
+                                                         row, col, FALSE);
+
+    if(icon && event->replaces != icon) {
+        xfdesktop_file_icon_manager_remove_replaced_icon(fmanager, event);
+        event->replaces = g_object_ref(icon);
+    }
+
+    if(event->state == FILE_EVENT_WAITING) {
+        g_queue_remove(&fmanager->priv->file_events_waiting, event);
+        g_queue_push_head(&fmanager->priv->file_events_waiting, event);
+        xfdesktop_file_icon_manager_start_file_queries(fmanager);
+    }
+}
+
+/* Drops any pending look up of @file, it's gone */
+static void
+xfdesktop_file_icon_manager_drop_file_event(XfdesktopFileIconManager *fmanager,
+                                            GFile *file)
+{
+    XfdesktopFileEvent *event;
+
+    if(!fmanager->priv->file_events)
+        return;
+
+    event = g_hash_table_lookup(fmanager->priv->file_events, file);
+    if(!event)
+        return;
+
+    /* nothing is going to take its place */
+    xfdesktop_file_icon_manager_remove_replaced_icon(fmanager, event);
+
+    switch(event->state) {
+        case FILE_EVENT_QUERYING:
+            /* the query callback still needs it */
+            event->discard = TRUE;
+            event->stale = FALSE;
+            return;
+        case FILE_EVENT_WAITING:
+            g_queue_remove(&fmanager->priv->file_events_waiting, event);
+            break;
+        case FILE_EVENT_READY:
+            g_queue_remove(&fmanager->priv->file_events_ready, event);
+            break;
+    }
+
+    g_hash_table_remove(fmanager->priv->file_events, file);
+}
+
 static void
 xfdesktop_file_icon_manager_file_changed(GFileMonitor     *monitor,
                                          GFile            *file,
@@ -2651,8 +3171,7 @@ xfdesktop_file_icon_manager_file_changed(GFileMonitor     *monitor,
                                          gpointer          user_data)
 {
     XfdesktopFileIconManager *fmanager = XFDESKTOP_FILE_ICON_MANAGER(user_data);
-    XfdesktopFileIcon *icon, *moved_icon;
-    GFileInfo *file_info;
+    XfdesktopFileIcon *icon;
     gint16 row = 0, col = 0;
     gchar *filename;
 
@@ -2662,9 +3181,6 @@ xfdesktop_file_icon_manager_file_changed(GFileMonitor     *monitor,
 
             icon = g_hash_table_lookup(fmanager->priv->icons, file);
 
-            file_info = g_file_query_info(other_file, XFDESKTOP_FILE_INFO_NAMESPACE,
-                                          G_FILE_QUERY_INFO_NONE, NULL, NULL);
-
             if(icon) {
                 /* Get the old position so we can use it for the new icon */
                 if(!xfdesktop_icon_get_position(XFDESKTOP_ICON(icon), &row, &col)) {
@@ -2672,67 +3188,36 @@ xfdesktop_file_icon_manager_file_changed(GFileMonitor     *monitor,
                     row = col = 0;
                 }
                 XF_DEBUG("row %d, col %d", row, col);
-
-                /* Remove the old icon */
-                xfdesktop_file_icon_manager_remove_icon(fmanager, icon);
-            }
-
-            /* Check to see if there's already an other_file represented on
-             * the desktop and remove it so there aren't duplicated icons
-             * present. */
-            moved_icon = g_hash_table_lookup(fmanager->priv->icons, other_file);
-            if(moved_icon) {
-                /* Since we're replacing an existing icon, get that location
-                 * to use instead */
-                if(!xfdesktop_icon_get_position(XFDESKTOP_ICON(moved_icon), &row, &col)) {
-                    /* Failed to get position... not supported? */
-                    row = col = 0;
-                }
-                XF_DEBUG("row %d, col %d", row, col);
-
-                xfdesktop_file_icon_manager_remove_icon(fmanager, moved_icon);
             }
+            xfdesktop_file_icon_manager_drop_file_event(fmanager, file);
 
             if(xfdesktop_compare_paths(g_file_get_parent(other_file), fmanager->priv->folder)) {
                 XF_DEBUG("icon moved off the desktop");
                 /* Nothing moved, this is actually a delete */
-                if(file_info)
-                    g_object_unref(file_info);
-
+                if(icon)
+                    xfdesktop_file_icon_manager_remove_icon(fmanager, icon);
                 return;
             }
 
-            if(file_info) {
-                /* Add the icon adding the row/col info */
-                icon = xfdesktop_file_icon_manager_add_regular_icon(fmanager,
-                                                                    other_file,
-                                                                    file_info,
-                                                                    row,
-                                                                    col,
-                                                                    FALSE);
-                if(icon)
-                    xfdesktop_file_icon_position_changed(icon, fmanager);
-
-                g_object_unref(file_info);
-            }
+            /* If other_file is already represented on the desktop, that
+             * icon keeps its spot and is updated in place, so there
+             * aren't duplicated icons present.  Otherwise the old icon is
+             * replaced with one at the same row/col once we know more
+             * about the file. */
+            xfdesktop_file_icon_manager_queue_move_event(fmanager, other_file,
+                                                         icon, row, col);
             break;
         case G_FILE_MONITOR_EVENT_ATTRIBUTE_CHANGED:
         case G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT:
             XF_DEBUG("got changed event");
 
-            icon = g_hash_table_lookup(fmanager->priv->icons, file);
-            if(icon) {
-                file_info = g_file_query_info(file, XFDESKTOP_FILE_INFO_NAMESPACE,
-                                              G_FILE_QUERY_INFO_NONE, NULL, NULL);
-
-                if(file_info) {
-                    /* update the icon if the file still exists */
-                    xfdesktop_file_icon_update_file_info(icon, file_info);
-                    g_object_unref(file_info);
-                } else {
-                    /* Remove the icon as it doesn't seem to exist */
-                    xfdesktop_file_icon_manager_remove_icon(fmanager, icon);
-                }
+            /* update the icon, or the one that's about to be created */
+            if(g_hash_table_lookup(fmanager->priv->icons, file)
+               || (fmanager->priv->file_events
+                   && g_hash_table_lookup(fmanager->priv->file_events, file)))
+            {
+                xfdesktop_file_icon_manager_queue_file_event(fmanager, file,
+                                                             -1, -1, FALSE);
             }
             break;
         case G_FILE_MONITOR_EVENT_CREATED:
@@ -2750,20 +3235,15 @@ xfdesktop_file_icon_manager_file_changed(GFileMonitor     *monitor,
                 xfdesktop_file_icon_manager_remove_icon(fmanager, icon);
             }
             
-            file_info = g_file_query_info(file, XFDESKTOP_FILE_INFO_NAMESPACE,
-                                          G_FILE_QUERY_INFO_NONE, NULL, NULL);
-            if(file_info) {
-                xfdesktop_file_icon_manager_add_regular_icon(fmanager,
-                                                             file, file_info,
-                                                             -1, -1,
-                                                             TRUE);
-
-                g_object_unref(file_info);
-            }
+            xfdesktop_file_icon_manager_queue_file_event(fmanager, file,
+                                                         -1, -1, FALSE);
             break;
         case G_FILE_MONITOR_EVENT_DELETED:
             XF_DEBUG("got deleted event");
 
+            /* don't bring it back once a running query finishes */
+            xfdesktop_file_icon_manager_drop_file_event(fmanager, file);
+
             filename = g_file_get_path(file);
 
             icon = g_hash_table_lookup(fmanager->priv->icons, file);
@@ -2819,19 +3299,12 @@ xfdesktop_file_icon_manager_update_file_info(gpointer key,
                                              gpointer value,
                                              gpointer user_data)
 {
-    XfdesktopFileIcon *icon = XFDESKTOP_FILE_ICON(value);
-    GFileInfo *file_info;
-
-    if(icon) {
-        file_info = g_file_query_info(key, XFDESKTOP_FILE_INFO_NAMESPACE,
-                                      G_FILE_QUERY_INFO_NONE, NULL, NULL);
+    XfdesktopFileIconManager *fmanager = XFDESKTOP_FILE_ICON_MANAGER(user_data);
 
-        if(file_info) {
-            /* update the icon if the file still exists */
-            xfdesktop_file_icon_update_file_info(icon, file_info);
-            g_object_unref(file_info);
-        }
-    }
+    /* the icon gets updated when the info comes in, a failed look up
+     * leaves it alone */
+    if(value)
+        xfdesktop_file_icon_manager_queue_file_event(fmanager, key, -1, -1, TRUE);
 }
 
 static gboolean
@@ -2892,17 +3365,33 @@ xfdesktop_file_icon_manager_files_ready(GFileEnumerator *enumerator,
     XfdesktopFileIconManager *fmanager;
     GError *error = NULL;
     GList *files, *l;
+    gint64 start_time, elapsed;
+
+    files = g_file_enumerator_next_files_finish(enumerator, result, &error);
+
+    /* the load was restarted or the manager shut down, user_data may
+     * not be around anymore */
+    if(g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+        g_error_free(error);
+        return;
+    }
 
     /* Sanity check */
-    if(user_data == NULL || !XFDESKTOP_IS_FILE_ICON_MANAGER(user_data))
+    if(user_data == NULL || !XFDESKTOP_IS_FILE_ICON_MANAGER(user_data)) {
+        g_list_free_full(files, g_object_unref);
+        if(error)
+            g_error_free(error);
         return;
+    }
 
     fmanager = XFDESKTOP_FILE_ICON_MANAGER(user_data);
 
-    if(enumerator != fmanager->priv->enumerator)
+    if(enumerator != fmanager->priv->enumerator) {
+        g_list_free_full(files, g_object_unref);
+        if(error)
+            g_error_free(error);
         return;
-
-    files = g_file_enumerator_next_files_finish(enumerator, result, &error);
+    }
 
     if(!files) {
         if(error) {
@@ -2913,10 +3402,13 @@ xfdesktop_file_icon_manager_files_ready(GFileEnumerator *enumerator,
                                 GTK_STOCK_DIALOG_WARNING, 
                                 _("Failed to load the desktop folder"), error->message,
                                 GTK_STOCK_CLOSE, GTK_RESPONSE_ACCEPT, NULL);
+            g_error_free(error);
         }
 
         g_object_unref(fmanager->priv->enumerator);
         fmanager->priv->enumerator = NULL;
+        g_object_unref(fmanager->priv->enumerate_cancellable);
+        fmanager->priv->enumerate_cancellable = NULL;
 
         /* initialize the file monitor */
         if(!fmanager->priv->monitor) {
@@ -2950,6 +3442,8 @@ xfdesktop_file_icon_manager_files_ready(GFileEnumerator *enumerator,
             g_free(location);
         }
     } else {
+        start_time = g_get_monotonic_time();
+
         for(l = files; l; l = l->next) {
             const gchar *name = g_file_info_get_name(l->data);
             GFile *file = g_file_get_child(fmanager->priv->folder, name);
@@ -2968,34 +3462,106 @@ xfdesktop_file_icon_manager_files_ready(GFileEnumerator *enumerator,
 
         g_list_free(files);
 
+        /* ask for more files per round trip while turning them into icons
+         * comfortably fits in a frame, and back off if it doesn't */
+        elapsed = g_get_monotonic_time() - start_time;
+        if(elapsed < LOAD_FRAME_BUDGET / 2) {
+            fmanager->priv->enumerate_batch_size = MIN(fmanager->priv->enumerate_batch_size * 2,
+                                                       ENUMERATE_BATCH_MAX);
+        } else if(elapsed > LOAD_FRAME_BUDGET) {
+            fmanager->priv->enumerate_batch_size = MAX(fmanager->priv->enumerate_batch_size / 2,
+                                                       ENUMERATE_BATCH_MIN);
+        }
+
+        XF_DEBUG("batch took %" G_GINT64_FORMAT " usec, next batch size %d",
+                 elapsed, fmanager->priv->enumerate_batch_size);
+
         g_file_enumerator_next_files_async(fmanager->priv->enumerator,
-                                           10, G_PRIORITY_DEFAULT, NULL,
+                                           fmanager->priv->enumerate_batch_size,
+                                           G_PRIORITY_DEFAULT,
+                                           fmanager->priv->enumerate_cancellable,
                                            (GAsyncReadyCallback) xfdesktop_file_icon_manager_files_ready,
                                            fmanager);
     }
 }
 
 static void
-xfdesktop_file_icon_manager_load_desktop_folder(XfdesktopFileIconManager *fmanager)
+xfdesktop_file_icon_manager_enumerator_ready(GFile *folder,
+                                             GAsyncResult *result,
+                                             gpointer user_data)
 {
-    
+    XfdesktopFileIconManager *fmanager;
+    GFileEnumerator *enumerator;
+    GError *error = NULL;
+
+    enumerator = g_file_enumerate_children_finish(folder, result, &error);
+
+    if(!enumerator) {
+        /* like a synchronous failure before, this leaves the desktop
+         * empty; a cancelled load has been superseded */
+        if(!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+            g_warning("Unable to enumerate the desktop folder: %s", error->message);
+        g_error_free(error);
+        return;
+    }
+
+    /* Sanity check */
+    if(user_data == NULL || !XFDESKTOP_IS_FILE_ICON_MANAGER(user_data)) {
+        g_object_unref(enumerator);
+        return;
+    }
+
+    fmanager = XFDESKTOP_FILE_ICON_MANAGER(user_data);
+
+    /* finished after a newer load was started or the manager shut down */
+    if(!fmanager->priv->enumerate_cancellable
+       || g_cancellable_is_cancelled(fmanager->priv->enumerate_cancellable))
+    {
+        g_object_unref(enumerator);
+        return;
+    }
+
+    fmanager->priv->enumerator = enumerator;
+    fmanager->priv->enumerate_batch_size = ENUMERATE_BATCH_MIN;
+
+    g_file_enumerator_next_files_async(fmanager->priv->enumerator,
+                                       fmanager->priv->enumerate_batch_size,
+                                       G_PRIORITY_DEFAULT,
+                                       fmanager->priv->enumerate_cancellable,
+                                       (GAsyncReadyCallback) xfdesktop_file_icon_manager_files_ready,
+                                       fmanager);
+}
+
+/* Stops a running load of the desktop folder */
+static void
+xfdesktop_file_icon_manager_cancel_load(XfdesktopFileIconManager *fmanager)
+{
+    if(fmanager->priv->enumerate_cancellable) {
+        g_cancellable_cancel(fmanager->priv->enumerate_cancellable);
+        g_object_unref(fmanager->priv->enumerate_cancellable);
+        fmanager->priv->enumerate_cancellable = NULL;
+    }
+
     if(fmanager->priv->enumerator) {
         g_object_unref(fmanager->priv->enumerator);
         fmanager->priv->enumerator = NULL;
     }
+}
 
-    fmanager->priv->enumerator = g_file_enumerate_children(fmanager->priv->folder,
-                                                           XFDESKTOP_FILE_INFO_NAMESPACE,
-                                                           G_FILE_QUERY_INFO_NONE,
-                                                           NULL, NULL);
+static void
+xfdesktop_file_icon_manager_load_desktop_folder(XfdesktopFileIconManager *fmanager)
+{
+    xfdesktop_file_icon_manager_cancel_load(fmanager);
 
-    if(fmanager->priv->enumerator) {
-        g_file_enumerator_next_files_async(fmanager->priv->enumerator,
-                                           10, G_PRIORITY_DEFAULT, NULL,
-                                           (GAsyncReadyCallback) xfdesktop_file_icon_manager_files_ready,
-                                           fmanager);
+    fmanager->priv->enumerate_cancellable = g_cancellable_new();
 
-    }
+    g_file_enumerate_children_async(fmanager->priv->folder,
+                                    XFDESKTOP_FILE_INFO_NAMESPACE,
+                                    G_FILE_QUERY_INFO_NONE,
+                                    G_PRIORITY_DEFAULT,
+                                    fmanager->priv->enumerate_cancellable,
+                                    (GAsyncReadyCallback) xfdesktop_file_icon_manager_enumerator_ready,
+                                    fmanager);
 }
 
 static void
@@ -3090,24 +3656,23 @@ xfdesktop_file_icon_manager_load_removable_media(XfdesktopFileIconManager *fmana
                      fmanager);
 }
 
-static void
-xfdesktop_file_icon_manager_ht_remove_removable_media(gpointer key,
-                                                      gpointer value,
-                                                      gpointer user_data)
-{
-    XfdesktopIcon *icon = XFDESKTOP_ICON(value);
-    XfdesktopFileIconManager *fmanager = XFDESKTOP_FILE_ICON_MANAGER(user_data);
-    
-    xfdesktop_icon_view_remove_item(fmanager->priv->icon_view, icon);
-}
-
 static void
 xfdesktop_file_icon_manager_remove_removable_media(XfdesktopFileIconManager *fmanager)
 {
     if(fmanager->priv->removable_icons) {
-        g_hash_table_foreach(fmanager->priv->removable_icons,
-                             xfdesktop_file_icon_manager_ht_remove_removable_media,
-                             fmanager);
+        GPtrArray *icons = g_ptr_array_sized_new(g_hash_table_size(fmanager->priv->removable_icons));
+        GHashTableIter iter;
+        gpointer value;
+
+        g_hash_table_iter_init(&iter, fmanager->priv->removable_icons);
+        while(g_hash_table_iter_next(&iter, NULL, &value))
+            g_ptr_array_add(icons, value);
+
+        xfdesktop_icon_view_remove_items(fmanager->priv->icon_view,
+                                         (XfdesktopIcon **)icons->pdata,
+                                         icons->len);
+        g_ptr_array_free(icons, TRUE);
+
         g_hash_table_destroy(fmanager->priv->removable_icons);
         fmanager->priv->removable_icons = NULL;
     }
@@ -3241,7 +3806,6 @@ static void
 xfdesktop_file_icon_manager_fini(XfdesktopIconViewManager *manager)
 {
     XfdesktopFileIconManager *fmanager = XFDESKTOP_FILE_ICON_MANAGER(manager);
-    gint i;
 
     if(!fmanager->priv->inited) {
         g_warning("Trying to de-init icon manager when it was never inited");
@@ -3250,10 +3814,7 @@ xfdesktop_file_icon_manager_fini(XfdesktopIconViewManager *manager)
 
     fmanager->priv->inited = FALSE;
     
-    if(fmanager->priv->enumerator) {
-        g_object_unref(fmanager->priv->enumerator);
-        fmanager->priv->enumerator = NULL;
-    }
+    xfdesktop_file_icon_manager_cancel_load(fmanager);
 
     g_signal_handlers_disconnect_by_func(G_OBJECT(fmanager->priv->icon_view),
                                          G_CALLBACK(icon_view_resized),
@@ -3278,21 +3839,9 @@ xfdesktop_file_icon_manager_fini(XfdesktopIconViewManager *manager)
     if(fmanager->priv->show_removable_media)
         xfdesktop_file_icon_manager_remove_removable_media(fmanager);
     
-    for(i = 0; i <= XFDESKTOP_SPECIAL_FILE_ICON_TRASH; ++i) {
-        XfdesktopIcon *icon = g_hash_table_lookup(fmanager->priv->special_icons,
-                                                  GINT_TO_POINTER(i));
-        if(icon) {
-            xfdesktop_icon_view_remove_item(fmanager->priv->icon_view, icon);
-            g_hash_table_remove(fmanager->priv->special_icons,
-                                GINT_TO_POINTER(i));
-        }
-    }
+    xfdesktop_file_icon_manager_remove_special_icons(fmanager);
 
-    if(fmanager->priv->icons) {
-        g_hash_table_foreach_remove(fmanager->priv->icons,
-                                    (GHRFunc)xfdesktop_remove_icons_ht,
-                                    fmanager);
-    }
+    xfdesktop_file_icon_manager_remove_regular_icons(fmanager);
 
     /* Stop the idle callback adding pending icons */
     if(fmanager->priv->pending_icons_id != 0) {
@@ -3306,6 +3855,8 @@ xfdesktop_file_icon_manager_fini(XfdesktopIconViewManager *manager)
         g_queue_free(fmanager->priv->pending_icons);
         fmanager->priv->pending_icons = NULL;
     }
+
+    xfdesktop_file_icon_manager_clear_file_events(fmanager);
     
     /* disconnect from the file monitor and release it */
     if(fmanager->priv->monitor) {
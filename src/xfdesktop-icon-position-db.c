@@ -0,0 +1,645 @@
+/*
+ *  xfdesktop - xfce4's desktop manager
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software Foundation,
+ *  Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+/* The saved positions of the desktop icons for one screen and workarea
+ * size.  The file starts with a small header followed by fixed-size
+ * records, each holding a 64-bit hash of the icon's identifier (or label)
+ * and its row and column.  The first n_records of them are sorted by key,
+ * so the file is simply mmap()ed and binary searched, nothing gets parsed.
+ *
+ * Every record after those is a journal entry: saving only appends the
+ * icons that moved since the last save, and a later entry for the same
+ * key wins.  Once the journal gets longer than the sorted part, or the
+ * file is found to be damaged, the next save writes a fresh sorted file
+ * and renames it over the old one.  The file is in native byte order, it
+ * never leaves the machine it was written on.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+
+#ifdef HAVE_SYS_TYPES_H
+#include <sys/types.h>
+#endif
+
+#ifdef HAVE_SYS_STAT_H
+#include <sys/stat.h>
+#endif
+
+#ifdef HAVE_ERRNO_H
+#include <errno.h>
+#endif
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+
+#include <libxfce4util/libxfce4util.h> /* for DBG/TRACE */
+
+#include "xfdesktop-common.h"
+#include "xfdesktop-icon-position-db.h"
+
+#define XFDESKTOP_ICON_POSITION_DB_MAGIC    0x50494658  /* "XFIP" */
+#define XFDESKTOP_ICON_POSITION_DB_VERSION  1
+/* the header flag saying the keys are icon identifiers, not labels */
+#define XFDESKTOP_ICON_POSITION_DB_KEYED_BY_IDENTIFIER  (1 << 0)
+/* the journal may always grow to at least this many records before the
+ * file is compacted */
+#define XFDESKTOP_ICON_POSITION_DB_MIN_JOURNAL  64
+
+typedef struct
+{
+    guint32 magic;
+    guint32 version;
+    guint32 flags;
+    guint32 n_records;
+} XfdesktopIconPositionDbHeader;
+
+typedef struct
+{
+    guint64 key;
+    gint16 row;
+    gint16 col;
+    /* catches torn or garbage records at the end of the journal */
+    guint32 check;
+} XfdesktopIconPositionDbRecord;
+
+typedef struct
+{
+    XfdesktopIconPositionDbRecord record;
+    /* not written to the file yet */
+    gboolean dirty;
+} XfdesktopIconPositionDbEntry;
+
+struct _XfdesktopIconPositionDb
+{
+    gchar *filename;
+
+    /* the sorted records, pointing into the mapping */
+    GMappedFile *mapped;
+    const XfdesktopIconPositionDbRecord *base;
+    guint n_base;
+
+    /* key -> entry for everything that changed since the file was last
+     * compacted, owns the entries */
+    GHashTable *overlay;
+    /* entries that still have to be appended */
+    GPtrArray *dirty;
+    guint n_journal;
+
+    gboolean keyed_by_identifier;
+    gboolean is_new;
+    /* the next save has to write a whole new file */
+    gboolean rewrite;
+};
+
+
+/* 64-bit FNV-1a, plenty to tell the icons on one desktop apart */
+static guint64
+xfdesktop_icon_position_db_hash(const gchar *name)
+{
+    guint64 hash = G_GUINT64_CONSTANT(0xcbf29ce484222325);
+    const guchar *p;
+
+    for(p = (const guchar *)name; *p; p++) {
+        hash ^= *p;
+        hash *= G_GUINT64_CONSTANT(0x100000001b3);
+    }
+
+    return hash;
+}
+
+static guint32
+xfdesktop_icon_position_db_record_check(const XfdesktopIconPositionDbRecord *record)
+{
+    return (guint32)(record->key ^ (record->key >> 32))
+           ^ (((guint32)(guint16)record->row << 16) | (guint16)record->col)
+           ^ XFDESKTOP_ICON_POSITION_DB_MAGIC;
+}
+
+static void
+xfdesktop_icon_position_db_record_init(XfdesktopIconPositionDbRecord *record,
+                                       guint64 key,
+                                       gint16 row,
+                                       gint16 col)
+{
+    record->key = key;
+    record->row = row;
+    record->col = col;
+    record->check = xfdesktop_icon_position_db_record_check(record);
+}
+
+static gint
+xfdesktop_icon_position_db_record_compare(gconstpointer a,
+                                          gconstpointer b)
+{
+    guint64 key_a = ((const XfdesktopIconPositionDbRecord *)a)->key;
+    guint64 key_b = ((const XfdesktopIconPositionDbRecord *)b)->key;
+
+    return key_a < key_b ? -1 : (key_a > key_b ? 1 : 0);
+}
+
+static const XfdesktopIconPositionDbRecord *
+xfdesktop_icon_position_db_find(XfdesktopIconPositionDb *db,
+                                guint64 key)
+{
+    XfdesktopIconPositionDbEntry *entry;
+    guint low, high, mid;
+
+    entry = g_hash_table_lookup(db->overlay, &key);
+    if(entry)
+        return &entry->record;
+
+    low = 0;
+    high = db->n_base;
+    while(low < high) {
+        mid = low + (high - low) / 2;
+        if(db->base[mid].key < key)
+            low = mid + 1;
+        else if(db->base[mid].key > key)
+            high = mid;
+        else
+            return &db->base[mid];
+    }
+
+    return NULL;
+}
+
+static XfdesktopIconPositionDbEntry *
+xfdesktop_icon_position_db_overlay_set(XfdesktopIconPositionDb *db,
+                                       guint64 key,
+                                       gint16 row,
+                                       gint16 col)
+{
+    XfdesktopIconPositionDbEntry *entry;
+
+    entry = g_hash_table_lookup(db->overlay, &key);
+    if(!entry) {
+        entry = g_slice_new0(XfdesktopIconPositionDbEntry);
+        xfdesktop_icon_position_db_record_init(&entry->record, key, row, col);
+        g_hash_table_insert(db->overlay, &entry->record.key, entry);
+    } else
+        xfdesktop_icon_position_db_record_init(&entry->record, key, row, col);
+
+    return entry;
+}
+
+static void
+xfdesktop_icon_position_db_entry_free(XfdesktopIconPositionDbEntry *entry)
+{
+    g_slice_free(XfdesktopIconPositionDbEntry, entry);
+}
+
+/* Drops everything held in memory */
+static void
+xfdesktop_icon_position_db_reset(XfdesktopIconPositionDb *db)
+{
+    if(db->mapped) {
+        g_mapped_file_unref(db->mapped);
+        db->mapped = NULL;
+    }
+    db->base = NULL;
+    db->n_base = 0;
+
+    g_hash_table_remove_all(db->overlay);
+    g_ptr_array_set_size(db->dirty, 0);
+    db->n_journal = 0;
+}
+
+/* (Re)maps the file.  Returns FALSE if there is no usable file, in which
+ * case the database is left empty. */
+static gboolean
+xfdesktop_icon_position_db_load(XfdesktopIconPositionDb *db)
+{
+    const XfdesktopIconPositionDbHeader *header;
+    const XfdesktopIconPositionDbRecord *records;
+    const gchar *contents;
+    gsize length, n_records, i;
+
+    xfdesktop_icon_position_db_reset(db);
+
+    db->mapped = g_mapped_file_new(db->filename, FALSE, NULL);
+    if(!db->mapped)
+        return FALSE;
+
+    contents = g_mapped_file_get_contents(db->mapped);
+    length = g_mapped_file_get_length(db->mapped);
+    header = (const XfdesktopIconPositionDbHeader *)contents;
+
+    if(length < sizeof(XfdesktopIconPositionDbHeader)
+       || header->magic != XFDESKTOP_ICON_POSITION_DB_MAGIC
+       || header->version != XFDESKTOP_ICON_POSITION_DB_VERSION
+       || header->n_records > (length - sizeof(XfdesktopIconPositionDbHeader))
+                              / sizeof(XfdesktopIconPositionDbRecord))
+    {
+        XF_DEBUG("invalid icon position file %s", db->filename);
+        xfdesktop_icon_position_db_reset(db);
+        return FALSE;
+    }
+
+    records = (const XfdesktopIconPositionDbRecord *)(contents + sizeof(XfdesktopIconPositionDbHeader));
+    n_records = (length - sizeof(XfdesktopIconPositionDbHeader))
+                / sizeof(XfdesktopIconPositionDbRecord);
+
+    db->base = records;
+    db->n_base = header->n_records;
+    db->keyed_by_identifier = (header->flags & XFDESKTOP_ICON_POSITION_DB_KEYED_BY_IDENTIFIER) != 0;
+
+    /* replay the journal */
+    for(i = db->n_base; i < n_records; i++) {
+        if(records[i].check != xfdesktop_icon_position_db_record_check(&records[i]))
+            break;
+
+        xfdesktop_icon_position_db_overlay_set(db, records[i].key,
+                                               records[i].row, records[i].col);
+        db->n_journal++;
+    }
+
+    /* anything appended after a torn record would never be read back, so
+     * start over with a clean file */
+    if(i < n_records
+       || sizeof(XfdesktopIconPositionDbHeader)
+          + n_records * sizeof(XfdesktopIconPositionDbRecord) != length)
+    {
+        XF_DEBUG("damaged journal in %s, it will be rewritten", db->filename);
+        db->rewrite = TRUE;
+    }
+
+    XF_DEBUG("mapped %s: %u records, %u in the journal",
+             db->filename, db->n_base, db->n_journal);
+
+    return TRUE;
+}
+
+/**
+ * xfdesktop_icon_position_db_open:
+ * @filename: The file the positions are stored in.
+ *
+ * Maps @filename if it exists.  A missing or unreadable file gives an empty
+ * database that is written from scratch on the first save.
+ *
+ * Return value: A new #XfdesktopIconPositionDb, free it with
+ *               xfdesktop_icon_position_db_free().
+ **/
+XfdesktopIconPositionDb *
+xfdesktop_icon_position_db_open(const gchar *filename)
+{
+    XfdesktopIconPositionDb *db;
+
+    g_return_val_if_fail(filename != NULL, NULL);
+
+    db = g_slice_new0(XfdesktopIconPositionDb);
+    db->filename = g_strdup(filename);
+    db->overlay = g_hash_table_new_full(g_int64_hash, g_int64_equal, NULL,
+                                        (GDestroyNotify)xfdesktop_icon_position_db_entry_free);
+    db->dirty = g_ptr_array_new();
+
+    if(!xfdesktop_icon_position_db_load(db)) {
+        db->is_new = TRUE;
+        db->rewrite = TRUE;
+    }
+
+    return db;
+}
+
+void
+xfdesktop_icon_position_db_free(XfdesktopIconPositionDb *db)
+{
+    if(!db)
+        return;
+
+    xfdesktop_icon_position_db_reset(db);
+    g_hash_table_destroy(db->overlay);
+    g_ptr_array_free(db->dirty, TRUE);
+    g_free(db->filename);
+    g_slice_free(XfdesktopIconPositionDb, db);
+}
+
+/**
+ * xfdesktop_icon_position_db_is_new:
+ * @db: An #XfdesktopIconPositionDb.
+ *
+ * Return value: %TRUE if there was no usable file when @db was opened, so
+ *               the positions may have to be imported from somewhere else.
+ **/
+gboolean
+xfdesktop_icon_position_db_is_new(XfdesktopIconPositionDb *db)
+{
+    g_return_val_if_fail(db != NULL, FALSE);
+
+    return db->is_new;
+}
+
+gboolean
+xfdesktop_icon_position_db_get_keyed_by_identifier(XfdesktopIconPositionDb *db)
+{
+    g_return_val_if_fail(db != NULL, FALSE);
+
+    return db->keyed_by_identifier;
+}
+
+void
+xfdesktop_icon_position_db_set_keyed_by_identifier(XfdesktopIconPositionDb *db,
+                                                   gboolean keyed_by_identifier)
+{
+    g_return_if_fail(db != NULL);
+
+    if(!db->keyed_by_identifier == !keyed_by_identifier)
+        return;
+
+    db->keyed_by_identifier = !!keyed_by_identifier;
+    /* the flag lives in the header */
+    db->rewrite = TRUE;
+}
+
+gboolean
+xfdesktop_icon_position_db_lookup(XfdesktopIconPositionDb *db,
+                                  const gchar *name,
+                                  gint16 *row,
+                                  gint16 *col)
+{
+    const XfdesktopIconPositionDbRecord *record;
+
+    g_return_val_if_fail(db != NULL && name != NULL, FALSE);
+
+    record = xfdesktop_icon_position_db_find(db,
+                                             xfdesktop_icon_position_db_hash(name));
+    if(!record)
+        return FALSE;
+
+    *row = record->row;
+    *col = record->col;
+
+    return TRUE;
+}
+
+/**
+ * xfdesktop_icon_position_db_set:
+ * @db: An #XfdesktopIconPositionDb.
+ * @name: The identifier or label of the icon.
+ * @row: The row of the icon.
+ * @col: The column of the icon.
+ *
+ * Remembers the position of @name.  Nothing is queued for the next save
+ * if the position didn't change.
+ **/
+void
+xfdesktop_icon_position_db_set(XfdesktopIconPositionDb *db,
+                               const gchar *name,
+                               gint16 row,
+                               gint16 col)
+{
+    XfdesktopIconPositionDbEntry *entry;
+    const XfdesktopIconPositionDbRecord *record;
+    guint64 key;
+
+    g_return_if_fail(db != NULL && name != NULL);
+
+    key = xfdesktop_icon_position_db_hash(name);
+
+    record = xfdesktop_icon_position_db_find(db, key);
+    if(record && record->row == row && record->col == col)
+        return;
+
+    entry = xfdesktop_icon_position_db_overlay_set(db, key, row, col);
+    if(!entry->dirty) {
+        entry->dirty = TRUE;
+        g_ptr_array_add(db->dirty, entry);
+    }
+}
+
+/**
+ * xfdesktop_icon_position_db_clear:
+ * @db: An #XfdesktopIconPositionDb.
+ *
+ * Forgets all positions.  The next save writes a new file with only the
+ * positions set after this.
+ **/
+void
+xfdesktop_icon_position_db_clear(XfdesktopIconPositionDb *db)
+{
+    g_return_if_fail(db != NULL);
+
+    xfdesktop_icon_position_db_reset(db);
+    db->rewrite = TRUE;
+}
+
+/**
+ * xfdesktop_icon_position_db_needs_compaction:
+ * @db: An #XfdesktopIconPositionDb.
+ *
+ * Return value: %TRUE if the next save is going to rewrite the whole file
+ *               anyway, which makes it a good time to drop the positions
+ *               of icons that are gone.
+ **/
+gboolean
+xfdesktop_icon_position_db_needs_compaction(XfdesktopIconPositionDb *db)
+{
+    g_return_val_if_fail(db != NULL, FALSE);
+
+    return db->rewrite
+           || db->n_journal > MAX(XFDESKTOP_ICON_POSITION_DB_MIN_JOURNAL, db->n_base);
+}
+
+/* Writes all records sorted into a new file and maps that */
+static gboolean
+xfdesktop_icon_position_db_compact(XfdesktopIconPositionDb *db)
+{
+    XfdesktopIconPositionDbHeader header = { 0, };
+    GArray *records;
+    GHashTableIter iter;
+    gpointer value;
+    GFile *file;
+    GFileOutputStream *stream;
+    GOutputStream *out;
+    gboolean ok = FALSE;
+    guint i;
+
+    records = g_array_sized_new(FALSE, FALSE, sizeof(XfdesktopIconPositionDbRecord),
+                                db->n_base + g_hash_table_size(db->overlay));
+
+    for(i = 0; i < db->n_base; i++) {
+        if(!g_hash_table_lookup(db->overlay, &db->base[i].key))
+            g_array_append_val(records, db->base[i]);
+    }
+
+    g_hash_table_iter_init(&iter, db->overlay);
+    while(g_hash_table_iter_next(&iter, NULL, &value)) {
+        XfdesktopIconPositionDbEntry *entry = value;
+        g_array_append_val(records, entry->record);
+    }
+
+    g_array_sort(records, xfdesktop_icon_position_db_record_compare);
+
+    header.magic = XFDESKTOP_ICON_POSITION_DB_MAGIC;
+    header.version = XFDESKTOP_ICON_POSITION_DB_VERSION;
+    header.flags = db->keyed_by_identifier ? XFDESKTOP_ICON_POSITION_DB_KEYED_BY_IDENTIFIER : 0;
+    header.n_records = records->len;
+
+    /* g_file_replace() writes to a temporary file and renames it over the
+     * old one, so a crash never leaves a half written file behind */
+    file = g_file_new_for_path(db->filename);
+    stream = g_file_replace(file, NULL, FALSE, G_FILE_CREATE_NONE, NULL, NULL);
+    if(stream) {
+        out = G_OUTPUT_STREAM(stream);
+
+        ok = g_output_stream_write_all(out, &header, sizeof(header),
+                                       NULL, NULL, NULL)
+             && g_output_stream_write_all(out, records->data,
+                                          records->len * sizeof(XfdesktopIconPositionDbRecord),
+                                          NULL, NULL, NULL);
+
+        /* closing the stream is what renames the temporary file, so
+         * cancel that if anything went wrong */
+        if(!ok) {
+            GCancellable *cancellable = g_cancellable_new();
+            g_cancellable_cancel(cancellable);
+            g_output_stream_close(out, cancellable, NULL);
+            g_object_unref(cancellable);
+        } else
+            ok = g_output_stream_close(out, NULL, NULL);
+
+        g_object_unref(stream);
+    }
+    g_object_unref(file);
+
+    g_array_free(records, TRUE);
+
+    if(!ok) {
+        g_warning("Unable to write icon positions to %s", db->filename);
+        return FALSE;
+    }
+
+    XF_DEBUG("compacted %s to %u records", db->filename, header.n_records);
+
+    db->rewrite = FALSE;
+    db->is_new = FALSE;
+
+    if(!xfdesktop_icon_position_db_load(db)) {
+        /* the file is there but can't be mapped, write it again next time
+         * with nothing but what gets set until then */
+        db->rewrite = TRUE;
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/* Appends the dirty entries to the journal.  If the file is gone or isn't
+ * the one that was mapped anymore, nothing is written and @stale is set, the
+ * records only make sense after what was mapped. */
+static gboolean
+xfdesktop_icon_position_db_append(XfdesktopIconPositionDb *db,
+                                  gboolean *stale)
+{
+    FILE *fp;
+    struct stat st;
+    guint i;
+    gboolean ok = TRUE;
+
+    *stale = FALSE;
+
+    /* not "ab", that would start a file without a header if it was
+     * deleted */
+    fp = g_fopen(db->filename, "r+b");
+    if(!fp) {
+        *stale = (errno == ENOENT);
+        return FALSE;
+    }
+
+    if(fstat(fileno(fp), &st) != 0
+       || (guint64)st.st_size != sizeof(XfdesktopIconPositionDbHeader)
+                                 + (guint64)(db->n_base + db->n_journal)
+                                   * sizeof(XfdesktopIconPositionDbRecord))
+    {
+        fclose(fp);
+        *stale = TRUE;
+        return FALSE;
+    }
+
+    if(fseek(fp, 0, SEEK_END) != 0) {
+        fclose(fp);
+        return FALSE;
+    }
+
+    for(i = 0; i < db->dirty->len && ok; i++) {
+        XfdesktopIconPositionDbEntry *entry = g_ptr_array_index(db->dirty, i);
+        ok = fwrite(&entry->record, sizeof(XfdesktopIconPositionDbRecord), 1, fp) == 1;
+    }
+
+    if(fclose(fp) != 0)
+        ok = FALSE;
+
+    if(!ok)
+        return FALSE;
+
+    XF_DEBUG("appended %u records to %s", db->dirty->len, db->filename);
+
+    db->n_journal += db->dirty->len;
+    for(i = 0; i < db->dirty->len; i++) {
+        XfdesktopIconPositionDbEntry *entry = g_ptr_array_index(db->dirty, i);
+        entry->dirty = FALSE;
+    }
+    g_ptr_array_set_size(db->dirty, 0);
+
+    return TRUE;
+}
+
+/**
+ * xfdesktop_icon_position_db_save:
+ * @db: An #XfdesktopIconPositionDb.
+ *
+ * Writes the positions that changed since the last save to the journal,
+ * or compacts the file if xfdesktop_icon_position_db_needs_compaction()
+ * said so, or if the file was deleted or replaced since it was mapped.
+ *
+ * Return value: %TRUE on success.
+ **/
+gboolean
+xfdesktop_icon_position_db_save(XfdesktopIconPositionDb *db)
+{
+    gboolean stale = FALSE;
+
+    g_return_val_if_fail(db != NULL, FALSE);
+
+    /* the same test the caller saw, so a compaction only ever happens
+     * when it had the chance to clear() the positions that are gone
+     * first.  the journal may end up one save's worth too long. */
+    if(xfdesktop_icon_position_db_needs_compaction(db))
+        return xfdesktop_icon_position_db_compact(db);
+
+    if(db->dirty->len == 0)
+        return TRUE;
+
+    if(!xfdesktop_icon_position_db_append(db, &stale)) {
+        if(stale) {
+            XF_DEBUG("%s changed behind our back, rewriting it", db->filename);
+            return xfdesktop_icon_position_db_compact(db);
+        }
+
+        g_warning("Unable to write icon positions to %s", db->filename);
+        /* part of a record may have made it to the file */
+        db->rewrite = TRUE;
+        return FALSE;
+    }
+
+    return TRUE;
+}
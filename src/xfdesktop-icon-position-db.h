@@ -0,0 +1,56 @@
+/*
+ *  xfdesktop - xfce4's desktop manager
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software Foundation,
+ *  Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#ifndef _XFDESKTOP_ICON_POSITION_DB_H_
+#define _XFDESKTOP_ICON_POSITION_DB_H_
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _XfdesktopIconPositionDb XfdesktopIconPositionDb;
+
+XfdesktopIconPositionDb *xfdesktop_icon_position_db_open (const gchar *filename);
+
+void xfdesktop_icon_position_db_free                     (XfdesktopIconPositionDb *db);
+
+gboolean xfdesktop_icon_position_db_is_new               (XfdesktopIconPositionDb *db);
+
+gboolean xfdesktop_icon_position_db_get_keyed_by_identifier(XfdesktopIconPositionDb *db);
+void xfdesktop_icon_position_db_set_keyed_by_identifier  (XfdesktopIconPositionDb *db,
+                                                          gboolean keyed_by_identifier);
+
+gboolean xfdesktop_icon_position_db_lookup               (XfdesktopIconPositionDb *db,
+                                                          const gchar *name,
+                                                          gint16 *row,
+                                                          gint16 *col);
+
+void xfdesktop_icon_position_db_set                      (XfdesktopIconPositionDb *db,
+                                                          const gchar *name,
+                                                          gint16 row,
+                                                          gint16 col);
+
+void xfdesktop_icon_position_db_clear                    (XfdesktopIconPositionDb *db);
+
+gboolean xfdesktop_icon_position_db_needs_compaction     (XfdesktopIconPositionDb *db);
+
+gboolean xfdesktop_icon_position_db_save                 (XfdesktopIconPositionDb *db);
+
+G_END_DECLS
+
+#endif
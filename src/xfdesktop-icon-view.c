@@ -71,6 +71,8 @@
 #define TEXT_HEIGHT       (CELL_SIZE - ICON_SIZE - SPACING - (CELL_PADDING * 2) - LABEL_RADIUS)
 #define MIN_MARGIN        8
 #define DEFAULT_RUBBERBAND_ALPHA  64
+#define DAMAGE_MAX_RECTS  16
+#define GRID_BITS_PER_WORD  ((gint)(sizeof(gulong) * 8))
 
 #if defined(DEBUG) && DEBUG > 0
 #define DUMP_GRID_LAYOUT(icon_view) \
@@ -109,6 +111,29 @@ typedef struct
     guint source_id;
 } XfdesktopIdleRepaintData;
 
+/* A label shaped for one icon, along with what it was shaped for */
+typedef struct
+{
+    PangoLayout *playout;
+    gchar *label;
+    gint width;
+    gint height;
+    PangoAlignment alignment;
+    PangoRectangle extents;
+
+    /* the label blurred into an A8 mask for its shadow, with the layout's
+     * origin at 0,0 in user space */
+    cairo_surface_t *shadow_mask;
+    gint shadow_blur_radius;
+} XfdesktopIconLabelLayout;
+
+/* Per icon; one layout for the full label and one for the ellipsized
+ * one, since that's the only thing selecting an icon changes */
+typedef struct
+{
+    XfdesktopIconLabelLayout layouts[2];
+} XfdesktopIconLabelCache;
+
 struct _XfdesktopIconViewPrivate
 {
     XfdesktopIconViewManager *manager;
@@ -131,6 +156,13 @@ struct _XfdesktopIconViewPrivate
     gint width;
     gint height;
 
+    /* the first workspace's _NET_WORKAREA size as last read by
+     * xfdesktop_icon_view_get_workarea_size(), dropped whenever the root
+     * window says it may have changed */
+    gboolean workarea_size_valid;
+    gint workarea_width;
+    gint workarea_height;
+
     gint xmargin;
     gint ymargin;
     gint xspacing;
@@ -139,6 +171,41 @@ struct _XfdesktopIconViewPrivate
     gint16 nrows;
     gint16 ncols;
     XfdesktopIcon **grid_layout;
+
+    /* one bit per cell of grid_layout, set while the cell is free, so
+     * finding a free cell looks at a whole word of cells at a time.  the
+     * words before grid_free_first_word have no free cells. */
+    gulong *grid_free_bits;
+    gint grid_free_first_word;
+    gint grid_n_free;
+
+    /* for each grid cell (indexed like grid_layout), the icons whose
+     * total extents overlap it, so painting and hit-testing only need to
+     * look at the icons near the area in question */
+    GSList **icon_index;
+    gint icon_index_size;
+    /* icon -> the cells it's in, as a GdkRectangle of columns and rows */
+    GHashTable *icon_index_cells;
+
+    /* areas waiting to be repainted.  invalidations are merged in here and
+     * handed to GDK in one go right before it processes the next frame */
+    GdkRectangle damage_rects[DAMAGE_MAX_RECTS];
+    gint n_damage_rects;
+    guint damage_flush_id;
+    guint64 damage_rects_submitted;
+    guint64 damage_rects_flushed;
+    guint64 damage_area_flushed;
+
+    /* when the desktop hands us its background, the wallpaper with the
+     * icons on top is kept in backing, so exposes are a single blit.
+     * backing_damage is what needs to be drawn again before that.
+     * use_backing_store is the xfconf switch to turn this off. */
+    gboolean use_backing_store;
+    GdkPixmap *background;
+    cairo_surface_t *backing;
+    gint backing_width;
+    gint backing_height;
+    GdkRegion *backing_damage;
     
     guint grid_resize_timeout;
     
@@ -292,11 +359,23 @@ static void xfdesktop_icon_view_invalidate_icon_pixbuf(XfdesktopIconView *icon_v
 
 static void xfdesktop_icon_view_paint_icon(XfdesktopIconView *icon_view,
                                            XfdesktopIcon *icon,
+                                           cairo_t *cr,
                                            GdkRectangle *area);
+static void xfdesktop_icon_view_invalidate_cached_surfaces(XfdesktopIconView *icon_view);
+static void xfdesktop_icon_view_invalidate_label_cache(XfdesktopIconView *icon_view);
 static void xfdesktop_icon_view_repaint_icons(XfdesktopIconView *icon_view,
+                                              cairo_t *cr,
                                               GdkRectangle *area);
+static gboolean xfdesktop_icon_view_update_backing(XfdesktopIconView *icon_view,
+                                                   cairo_t *target_cr,
+                                                   GdkRegion *area);
+static void xfdesktop_icon_view_damage_backing(XfdesktopIconView *icon_view,
+                                               const GdkRectangle *area);
+static void xfdesktop_icon_view_invalidate_backing(XfdesktopIconView *icon_view);
+static void xfdesktop_icon_view_drop_backing(XfdesktopIconView *icon_view);
                                   
 static void xfdesktop_setup_grids(XfdesktopIconView *icon_view);
+static void xfdesktop_grid_reset_free_bits(XfdesktopIconView *icon_view);
 static gboolean xfdesktop_grid_get_next_free_position(XfdesktopIconView *icon_view,
                                                       gint16 *row,
                                                       gint16 *col);
@@ -317,10 +396,20 @@ static inline XfdesktopIcon *xfdesktop_icon_view_icon_in_cell_raw(XfdesktopIconV
 static inline XfdesktopIcon *xfdesktop_icon_view_icon_in_cell(XfdesktopIconView *icon_view,
                                                               gint16 row,
                                                               gint16 col);
-static gint xfdesktop_check_icon_clicked(gconstpointer data,
-                                         gconstpointer user_data);
+static void xfdesktop_icon_view_index_icon(XfdesktopIconView *icon_view,
+                                           XfdesktopIcon *icon);
+static void xfdesktop_icon_view_unindex_icon(XfdesktopIconView *icon_view,
+                                             XfdesktopIcon *icon);
+static void xfdesktop_icon_view_rebuild_index(XfdesktopIconView *icon_view);
+static GSList *xfdesktop_icon_view_icons_in_area(XfdesktopIconView *icon_view,
+                                                 const GdkRectangle *area);
+static XfdesktopIcon *xfdesktop_icon_view_icon_at_point(XfdesktopIconView *icon_view,
+                                                        gint x,
+                                                        gint y);
 static void xfdesktop_list_foreach_invalidate(gpointer data,
                                               gpointer user_data);
+static void xfdesktop_list_foreach_unset_selected(gpointer data,
+                                                  gpointer user_data);
 
 static inline void xfdesktop_xy_to_rowcol(XfdesktopIconView *icon_view,
                                           gint x,
@@ -343,8 +432,6 @@ static void xfdesktop_icon_view_modify_font_size(XfdesktopIconView *icon_view,
                                                  gdouble size);
 static void xfdesktop_icon_view_add_item_internal(XfdesktopIconView *icon_view,
                                                   XfdesktopIcon *icon);
-static gboolean xfdesktop_icon_view_icon_find_position(XfdesktopIconView *icon_view,
-                                                       XfdesktopIcon *icon);
 static gboolean xfdesktop_icon_view_shift_area_to_cell(XfdesktopIconView *icon_view,
                                                        XfdesktopIcon *icon,
                                                        GdkRectangle *text_area);
@@ -385,6 +472,7 @@ enum
     PROP_SINGLE_CLICK,
     PROP_SHOW_TOOLTIPS,
     PROP_TOOLTIP_SIZE,
+    PROP_USE_BACKING_STORE,
 };
 
 
@@ -396,6 +484,7 @@ static const gint icon_view_n_targets = 1;
 static guint __signals[SIG_N_SIGNALS] = { 0, };
 
 static GQuark xfdesktop_cell_highlight_quark = 0;
+static GQuark xfdesktop_label_cache_quark = 0;
 
 
 G_DEFINE_TYPE(XfdesktopIconView, xfdesktop_icon_view, GTK_TYPE_WIDGET)
@@ -647,6 +736,13 @@ xfdesktop_icon_view_class_init(XfdesktopIconViewClass *klass)
                                                         -1, MAX_TOOLTIP_SIZE, -1,
                                                         XFDESKTOP_PARAM_FLAGS));
 
+    g_object_class_install_property(gobject_class, PROP_USE_BACKING_STORE,
+                                    g_param_spec_boolean("use-backing-store",
+                                                         "use backing store",
+                                                         "keep the wallpaper and icons in an off-screen copy",
+                                                         TRUE,
+                                                         XFDESKTOP_PARAM_FLAGS));
+
 #undef XFDESKTOP_PARAM_FLAGS
 
     /* same binding entries as GtkIconView */
@@ -708,6 +804,7 @@ xfdesktop_icon_view_class_init(XfdesktopIconViewClass *klass)
                                          GTK_MOVEMENT_VISUAL_POSITIONS, -1);
 
     xfdesktop_cell_highlight_quark = g_quark_from_static_string("xfdesktop-icon-view-cell-highlight");
+    xfdesktop_label_cache_quark = g_quark_from_static_string("xfdesktop-icon-view-label-cache");
 }
 
 static void
@@ -722,6 +819,10 @@ xfdesktop_icon_view_init(XfdesktopIconView *icon_view)
 
     icon_view->priv->allow_rubber_banding = TRUE;
     icon_view->priv->selection_box_alpha = DEFAULT_RUBBERBAND_ALPHA;
+
+    icon_view->priv->icon_index_cells = g_hash_table_new_full(g_direct_hash,
+                                                              g_direct_equal,
+                                                              NULL, g_free);
     
     icon_view->priv->native_targets = gtk_target_list_new(icon_view_targets,
                                                           icon_view_n_targets);
@@ -746,12 +847,23 @@ static void
 xfdesktop_icon_view_finalize(GObject *obj)
 {
     XfdesktopIconView *icon_view = XFDESKTOP_ICON_VIEW(obj);
+    gint i;
     
     if(icon_view->priv->manager) {
         xfdesktop_icon_view_manager_fini(icon_view->priv->manager);
         g_object_unref(G_OBJECT(icon_view->priv->manager));
     }
     
+    if(icon_view->priv->damage_flush_id)
+        g_source_remove(icon_view->priv->damage_flush_id);
+
+    if(icon_view->priv->background)
+        g_object_unref(G_OBJECT(icon_view->priv->background));
+    if(icon_view->priv->backing)
+        cairo_surface_destroy(icon_view->priv->backing);
+    if(icon_view->priv->backing_damage)
+        gdk_region_destroy(icon_view->priv->backing_damage);
+
     gtk_target_list_unref(icon_view->priv->native_targets);
     gtk_target_list_unref(icon_view->priv->source_targets);
     gtk_target_list_unref(icon_view->priv->dest_targets);
@@ -760,6 +872,11 @@ xfdesktop_icon_view_finalize(GObject *obj)
     g_list_free(icon_view->priv->pending_icons);
     /* icon_view->priv->icons should be cleared in _unrealize() */
 
+    for(i = 0; i < icon_view->priv->icon_index_size; i++)
+        g_slist_free(icon_view->priv->icon_index[i]);
+    g_free(icon_view->priv->icon_index);
+    g_hash_table_destroy(icon_view->priv->icon_index_cells);
+
     if (icon_view->priv->channel)
         icon_view->priv->channel = NULL;
 
@@ -787,6 +904,14 @@ xfce_icon_view_set_property(GObject *object,
             icon_view->priv->tooltip_size_from_xfconf = g_value_get_double(value);
             break;
 
+        case PROP_USE_BACKING_STORE:
+            if(icon_view->priv->use_backing_store == g_value_get_boolean(value))
+                break;
+            icon_view->priv->use_backing_store = g_value_get_boolean(value);
+            xfdesktop_icon_view_drop_backing(icon_view);
+            gtk_widget_queue_draw(GTK_WIDGET(icon_view));
+            break;
+
         default:
             G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
             break;
@@ -814,6 +939,10 @@ xfce_icon_view_get_property(GObject *object,
             g_value_set_double(value, icon_view->priv->tooltip_size_from_xfconf);
             break;
 
+        case PROP_USE_BACKING_STORE:
+            g_value_set_boolean(value, icon_view->priv->use_backing_store);
+            break;
+
         default:
             G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
             break;
@@ -871,8 +1000,6 @@ xfdesktop_icon_view_button_press(GtkWidget *widget,
     TRACE("entering");
 
     if(evt->type == GDK_BUTTON_PRESS) {
-        GList *icon_l;
-
         /* Let xfce-desktop handle button 2 */
         if(evt->button == 2) {
             /* If we had the grab release it so the desktop gets the event */
@@ -886,9 +1013,8 @@ xfdesktop_icon_view_button_press(GtkWidget *widget,
         if(!gtk_widget_has_grab(widget))
             gtk_grab_add(widget);
 
-        icon_l = g_list_find_custom(icon_view->priv->icons, evt,
-                                    (GCompareFunc)xfdesktop_check_icon_clicked);
-        if(icon_l && (icon = icon_l->data)) {
+        icon = xfdesktop_icon_view_icon_at_point(icon_view, evt->x, evt->y);
+        if(icon) {
             if(xfdesktop_icon_view_is_icon_selected(icon_view, icon)) {
                 /* clicked an already-selected icon */
                 
@@ -981,9 +1107,8 @@ xfdesktop_icon_view_button_press(GtkWidget *widget,
         icon_view->priv->definitely_rubber_banding = FALSE;
         
         if(evt->button == 1) {
-            GList *icon_l = g_list_find_custom(icon_view->priv->icons, evt,
-                                               (GCompareFunc)xfdesktop_check_icon_clicked);
-            if(icon_l && (icon = icon_l->data)) {
+            icon = xfdesktop_icon_view_icon_at_point(icon_view, evt->x, evt->y);
+            if(icon) {
                 icon_view->priv->cursor = icon;
                 g_signal_emit(G_OBJECT(icon_view), __signals[SIG_ICON_ACTIVATED],
                               0, NULL);
@@ -1026,8 +1151,7 @@ xfdesktop_icon_view_button_release(GtkWidget *widget,
                                    gpointer user_data)
 {
     XfdesktopIconView *icon_view = XFDESKTOP_ICON_VIEW(user_data);
-    XfdesktopIcon *icon;
-    GList *icon_l = NULL;
+    XfdesktopIcon *icon = NULL;
 
     TRACE("entering btn=%d", evt->button);
 
@@ -1040,9 +1164,8 @@ xfdesktop_icon_view_button_release(GtkWidget *widget,
        && !icon_view->priv->definitely_rubber_banding
        && !icon_view->priv->double_click) {
         /* Find out if we clicked on an icon */
-        icon_l = g_list_find_custom(icon_view->priv->icons, evt,
-                                    (GCompareFunc)xfdesktop_check_icon_clicked);
-        if(icon_l && (icon = icon_l->data)) {
+        icon = xfdesktop_icon_view_icon_at_point(icon_view, evt->x, evt->y);
+        if(icon) {
             /* We did, activate it */
             icon_view->priv->cursor = icon;
             g_signal_emit(G_OBJECT(icon_view), __signals[SIG_ICON_ACTIVATED],
@@ -1058,26 +1181,23 @@ xfdesktop_icon_view_button_release(GtkWidget *widget,
     {
         /* If we're in single click mode we may already have the icon, don't
          * find it again. */
-        if(icon_l == NULL) {
-            icon_l = g_list_find_custom(icon_view->priv->icons, evt,
-                                        (GCompareFunc)xfdesktop_check_icon_clicked);
-        }
+        if(icon == NULL)
+            icon = xfdesktop_icon_view_icon_at_point(icon_view, evt->x, evt->y);
 
         /* If we clicked an icon then we didn't pop up the menu during the
          * button press in order to support right click DND, pop up the menu
          * now.
          * We pass 0 as the button because the docs say that you must use 0
          * for pop ups other than button press events. */
-        if(icon_l && (icon = icon_l->data))
+        if(icon)
             xfce_desktop_popup_root_menu(XFCE_DESKTOP(widget), 0, evt->time);
     }
 
     if(evt->button == 1 && evt->state & GDK_CONTROL_MASK
        && icon_view->priv->control_click)
     {
-        icon_l = g_list_find_custom(icon_view->priv->icons, evt,
-                                    (GCompareFunc)xfdesktop_check_icon_clicked);
-        if(icon_l && (icon = icon_l->data)) {
+        icon = xfdesktop_icon_view_icon_at_point(icon_view, evt->x, evt->y);
+        if(icon) {
             if(xfdesktop_icon_view_is_icon_selected(icon_view, icon)) {
                 /* clicked an already-selected icon */
 
@@ -1243,6 +1363,55 @@ xfdesktop_icon_view_show_tooltip(GtkWidget *widget,
     return TRUE;
 }
 
+/* Brings the selection state of @icon in line with the rubber band going
+ * from @old_rect to @new_rect, without repainting or emitting anything.
+ * Only icons the old band touched get unselected, so CTRL + rubber band
+ * keeps the icons that were selected before (Bug 10275).  Adds the area
+ * to repaint to @invalid_region and returns TRUE if the state changed. */
+static gboolean
+xfdesktop_icon_view_band_update_icon(XfdesktopIconView *icon_view,
+                                     XfdesktopIcon *icon,
+                                     const GdkRectangle *old_rect,
+                                     const GdkRectangle *new_rect,
+                                     GdkRegion *invalid_region)
+{
+    GdkRectangle extents, pixbuf_extents, text_extents, box_extents;
+
+    if(!xfdesktop_icon_get_extents(icon, NULL, NULL, &extents))
+        return FALSE;
+
+    if(gdk_rectangle_intersect(&extents, new_rect, NULL)) {
+        if(xfdesktop_icon_get_is_selected(icon))
+            return FALSE;
+
+        icon_view->priv->selected_icons = g_list_prepend(icon_view->priv->selected_icons,
+                                                         icon);
+        xfdesktop_icon_set_is_selected(icon, TRUE);
+        xfdesktop_icon_selected(icon);
+    } else if(xfdesktop_icon_get_is_selected(icon)
+              && gdk_rectangle_intersect(&extents, old_rect, NULL))
+    {
+        icon_view->priv->selected_icons = g_list_remove(icon_view->priv->selected_icons,
+                                                        icon);
+        xfdesktop_icon_set_is_selected(icon, FALSE);
+    } else
+        return FALSE;
+
+    /* the label isn't ellipsized the same way when the icon is selected,
+     * so repaint both the old and the new extents */
+    gdk_region_union_with_rect(invalid_region, &extents);
+    xfdesktop_icon_view_damage_backing(icon_view, &extents);
+    if(xfdesktop_icon_view_update_icon_extents(icon_view, icon,
+                                               &pixbuf_extents, &text_extents,
+                                               &box_extents, &extents))
+    {
+        gdk_region_union_with_rect(invalid_region, &extents);
+        xfdesktop_icon_view_damage_backing(icon_view, &extents);
+    }
+
+    return TRUE;
+}
+
 static gboolean
 xfdesktop_icon_view_motion_notify(GtkWidget *widget,
                                   GdkEventMotion *evt,
@@ -1265,9 +1434,10 @@ xfdesktop_icon_view_motion_notify(GtkWidget *widget,
                    && !icon_view->priv->definitely_rubber_banding)
                   || icon_view->priv->definitely_rubber_banding))
     {
-        GdkRectangle old_rect, *new_rect, intersect;
-        GdkRegion *region;
-        GList *l;
+        GdkRectangle old_rect, *new_rect, intersect, *rects = NULL;
+        GdkRegion *region, *delta;
+        gint n_rects = 0, i;
+        gboolean selection_changed = FALSE;
 
         /* we're dragging with no icon under the cursor -> rubber band start
          * OR, we're already doin' the band -> update it */
@@ -1306,55 +1476,43 @@ xfdesktop_icon_view_motion_notify(GtkWidget *widget,
             gdk_region_destroy(region_intersect);
         }
 
-        gdk_window_invalidate_region(gtk_widget_get_window(widget), region, TRUE);
-        gdk_region_destroy(region);
-
-        /* update list of selected icons */
+        /* update list of selected icons.  an icon can only change state if
+         * it's in the part of the desktop the band just grew into or moved
+         * away from, so only look at those.  the icons are repainted along
+         * with the band and the selection change is announced once. */
+        delta = gdk_region_rectangle(&old_rect);
+        gdk_region_union_with_rect(delta, new_rect);
+        if(gdk_rectangle_intersect(&old_rect, new_rect, &intersect)) {
+            GdkRegion *region_intersect = gdk_region_rectangle(&intersect);
+            gdk_region_subtract(delta, region_intersect);
+            gdk_region_destroy(region_intersect);
+        }
 
-        /* first pass: if the rubber band area got smaller at least in
-         * one dimension, we can try first to just remove icons that
-         * aren't in the band anymore */
-        if(old_rect.width > new_rect->width
-           || old_rect.height > new_rect->height)
-        {
-            l = icon_view->priv->selected_icons;
-            while(l) {
-                GdkRectangle extents, dummy;
-                XfdesktopIcon *icon = l->data;
+        gdk_region_get_rectangles(delta, &rects, &n_rects);
+        for(i = 0; i < n_rects; i++) {
+            GSList *icons, *sl;
 
-                /* To be removed, it must intersect the old rectangle and
-                 * not intersect the new one. This way CTRL + rubber band
-                 * works properly (Bug 10275) */
-                if(xfdesktop_icon_get_extents(icon, NULL, NULL, &extents)
-                   && gdk_rectangle_intersect(&extents, &old_rect, NULL)
-                   && !gdk_rectangle_intersect(&extents, new_rect, &dummy))
+            icons = xfdesktop_icon_view_icons_in_area(icon_view, &rects[i]);
+            for(sl = icons; sl; sl = sl->next) {
+                if(xfdesktop_icon_view_band_update_icon(icon_view, sl->data,
+                                                        &old_rect, new_rect,
+                                                        region))
                 {
-                    /* remove the icon from the selected list */
-                    l = l->next;
-                    xfdesktop_icon_view_unselect_item(icon_view, icon);
-                } else
-                    l = l->next;
+                    selection_changed = TRUE;
+                }
             }
+            g_slist_free(icons);
         }
+        g_free(rects);
+        gdk_region_destroy(delta);
 
-        /* second pass: if at least one dimension got larger, unfortunately
-         * we have to figure out what icons to add to the selected list */
-        if(old_rect.width < new_rect->width
-           || old_rect.height < new_rect->height)
-        {
-            for(l = icon_view->priv->icons; l; l = l->next) {
-                GdkRectangle extents, dummy;
-                XfdesktopIcon *icon = l->data;
+        gdk_window_invalidate_region(gtk_widget_get_window(widget), region, TRUE);
+        gdk_region_destroy(region);
 
-                if(xfdesktop_icon_get_extents(icon, NULL, NULL, &extents)
-                   && gdk_rectangle_intersect(&extents, new_rect, &dummy)
-                   && !xfdesktop_icon_view_is_icon_selected(icon_view, icon))
-                {
-                    /* since _select_item() prepends to the list, we
-                     * should be ok just calling this */
-                    xfdesktop_icon_view_select_item(icon_view, icon);
-                }
-            }
+        if(selection_changed) {
+            g_signal_emit(G_OBJECT(icon_view),
+                          __signals[SIG_ICON_SELECTION_CHANGED],
+                          0, NULL);
         }
     } else {
         XfdesktopIcon *icon;
@@ -1910,6 +2068,7 @@ static void
 xfdesktop_icon_view_icon_theme_changed(GtkIconTheme *icon_theme,
                                        gpointer user_data)
 {
+    xfdesktop_icon_view_invalidate_cached_surfaces(XFDESKTOP_ICON_VIEW(user_data));
     gtk_widget_queue_draw(GTK_WIDGET(user_data));
 }    
 
@@ -2014,6 +2173,10 @@ xfdesktop_icon_view_style_set(GtkWidget *widget,
     GTK_WIDGET_CLASS(xfdesktop_icon_view_parent_class)->style_set(widget,
                                                                   previous_style);
 
+    xfdesktop_icon_view_invalidate_cached_surfaces(icon_view);
+    /* the font may have changed along with the style */
+    xfdesktop_icon_view_invalidate_label_cache(icon_view);
+
     /* do this after we're sure we have a style set */
     if(!icon_view->priv->selection_box_color) {
         GtkStyle *style = gtk_widget_get_style(widget);
@@ -2118,6 +2281,7 @@ xfdesktop_icon_view_unrealize(GtkWidget *widget)
     gscreen = gtk_widget_get_screen(widget);
     groot = gdk_screen_get_root_window(gscreen);
     gdk_window_remove_filter(groot, xfdesktop_rootwin_watch_workarea, icon_view);
+    icon_view->priv->workarea_size_valid = FALSE;
     
     g_signal_handlers_disconnect_by_func(G_OBJECT(gtk_icon_theme_get_for_screen(gscreen)),
                      G_CALLBACK(xfdesktop_icon_view_icon_theme_changed),
@@ -2142,19 +2306,38 @@ xfdesktop_icon_view_unrealize(GtkWidget *widget)
         g_source_remove(icon_view->priv->grid_resize_timeout);
         icon_view->priv->grid_resize_timeout = 0;
     }
+
+    if(icon_view->priv->damage_flush_id) {
+        g_source_remove(icon_view->priv->damage_flush_id);
+        icon_view->priv->damage_flush_id = 0;
+    }
+    icon_view->priv->n_damage_rects = 0;
+
+    if(icon_view->priv->backing) {
+        cairo_surface_destroy(icon_view->priv->backing);
+        icon_view->priv->backing = NULL;
+    }
     
     g_signal_handlers_disconnect_by_func(G_OBJECT(gscreen),
                                          G_CALLBACK(xfdesktop_screen_size_changed_cb),
                                          icon_view);
     
     /* FIXME: really clear these? */
+    g_list_foreach(icon_view->priv->selected_icons,
+                   xfdesktop_list_foreach_unset_selected, NULL);
     g_list_free(icon_view->priv->selected_icons);
     icon_view->priv->selected_icons = NULL;
 
     xfdesktop_move_all_icons_to_pending_icons_list(icon_view);
+    /* the cached surfaces belong to the window we're losing */
+    xfdesktop_icon_view_invalidate_cached_surfaces(icon_view);
+    xfdesktop_icon_view_invalidate_label_cache(icon_view);
 
     g_free(icon_view->priv->grid_layout);
     icon_view->priv->grid_layout = NULL;
+    g_free(icon_view->priv->grid_free_bits);
+    icon_view->priv->grid_free_bits = NULL;
+    icon_view->priv->grid_n_free = 0;
     
     g_object_unref(G_OBJECT(icon_view->priv->playout));
     icon_view->priv->playout = NULL;
@@ -2186,6 +2369,7 @@ xfdesktop_icon_view_expose(GtkWidget *widget,
     GdkRectangle *rects = NULL;
     GdkRectangle clipbox;
     gint n_rects = 0, i;
+    cairo_t *cr;
 
     /*TRACE("entering");*/
     
@@ -2195,13 +2379,25 @@ xfdesktop_icon_view_expose(GtkWidget *widget,
     gdk_region_get_rectangles(evt->region, &rects, &n_rects);
     gdk_region_get_clipbox(evt->region, &clipbox);
 
-    xfdesktop_icon_view_repaint_icons(icon_view, &clipbox);
+    cr = gdk_cairo_create(GDK_DRAWABLE(gtk_widget_get_window(widget)));
+
+    if(icon_view->priv->background
+       && icon_view->priv->use_backing_store
+       && xfdesktop_icon_view_update_backing(icon_view, cr, evt->region))
+    {
+        cairo_save(cr);
+        gdk_cairo_region(cr, evt->region);
+        cairo_clip(cr);
+        cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+        cairo_set_source_surface(cr, icon_view->priv->backing, 0, 0);
+        cairo_paint(cr);
+        cairo_restore(cr);
+    } else
+        xfdesktop_icon_view_repaint_icons(icon_view, cr, &clipbox);
 
     if(icon_view->priv->definitely_rubber_banding) {
         GdkRectangle intersect;
-        cairo_t *cr;
 
-        cr = gdk_cairo_create(GDK_DRAWABLE(gtk_widget_get_window(widget)));
         cairo_set_line_width(cr, 1);
         cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
         cairo_set_source_rgba(cr,
@@ -2239,10 +2435,9 @@ xfdesktop_icon_view_expose(GtkWidget *widget,
 
             cairo_restore(cr);
         }
-
-        cairo_destroy(cr);
     }
 
+    cairo_destroy(cr);
     g_free(rects);
 
     return FALSE;
@@ -2281,7 +2476,7 @@ xfdesktop_icon_view_real_toggle_cursor_item(XfdesktopIconView *icon_view)
     if(!icon_view->priv->cursor)
         return;
 
-    if(g_list_find(icon_view->priv->selected_icons, icon_view->priv->cursor))
+    if(xfdesktop_icon_view_is_icon_selected(icon_view, icon_view->priv->cursor))
         xfdesktop_icon_view_unselect_item(icon_view, icon_view->priv->cursor);
     else
         xfdesktop_icon_view_select_item(icon_view, icon_view->priv->cursor);
@@ -2581,6 +2776,8 @@ xfdesktop_screen_size_changed_cb(GdkScreen *gscreen,
                                  gpointer user_data)
 {
     XfdesktopIconView *icon_view = XFDESKTOP_ICON_VIEW(user_data);
+
+    icon_view->priv->workarea_size_valid = FALSE;
     
    /* this is kinda icky.  we want to use _NET_WORKAREA to reset the size of
      * the grid, but we can never be sure it'll actually change.  so let's
@@ -2594,36 +2791,96 @@ xfdesktop_screen_size_changed_cb(GdkScreen *gscreen,
 
 static void
 xfdesktop_icon_view_repaint_icons(XfdesktopIconView *icon_view,
+                                  cairo_t *cr,
                                   GdkRectangle *area)
 {
-    GdkRectangle extents, dummy;
-    GList *l;
+    GSList *icons, *selected_icons = NULL, *l;
     XfdesktopIcon *icon;
-    
+
+    /* collect them first, painting an icon moves it around in the index */
+    icons = xfdesktop_icon_view_icons_in_area(icon_view, area);
+
     /* fist paint non-selected items, then paint selected items */
-    for(l = icon_view->priv->icons; l; l = l->next) {
+    for(l = icons; l; l = l->next) {
         icon = (XfdesktopIcon *)l->data;
         if (xfdesktop_icon_view_is_icon_selected(icon_view, icon))
-            continue;
-
-        if(!xfdesktop_icon_get_extents(icon, NULL, NULL, &extents)
-           || gdk_rectangle_intersect(area, &extents, &dummy))
-        {
-            xfdesktop_icon_view_paint_icon(icon_view, icon, area);
-        }
+            selected_icons = g_slist_prepend(selected_icons, icon);
+        else
+            xfdesktop_icon_view_paint_icon(icon_view, icon, cr, area);
     }
     
-    for(l = icon_view->priv->icons; l; l = l->next) {
-        icon = (XfdesktopIcon *)l->data;
-        if (!xfdesktop_icon_view_is_icon_selected(icon_view, icon))
-            continue;
+    for(l = selected_icons; l; l = l->next)
+        xfdesktop_icon_view_paint_icon(icon_view, l->data, cr, area);
 
-        if(!xfdesktop_icon_get_extents(icon, NULL, NULL, &extents)
-           || gdk_rectangle_intersect(area, &extents, &dummy))
-        {
-            xfdesktop_icon_view_paint_icon(icon_view, icon, area);
+    g_slist_free(selected_icons);
+    g_slist_free(icons);
+}
+
+/* Brings the parts of the backing store within @area up to date, making a
+ * new one first if the widget changed size.  @target_cr draws to the
+ * window.  Returns FALSE if there's no backing store to blit. */
+static gboolean
+xfdesktop_icon_view_update_backing(XfdesktopIconView *icon_view,
+                                   cairo_t *target_cr,
+                                   GdkRegion *area)
+{
+    GtkAllocation allocation;
+    GdkRegion *update;
+    GdkRectangle clipbox;
+    cairo_t *cr;
+
+    gtk_widget_get_allocation(GTK_WIDGET(icon_view), &allocation);
+
+    if(!icon_view->priv->backing
+       || icon_view->priv->backing_width != allocation.width
+       || icon_view->priv->backing_height != allocation.height)
+    {
+        GdkRectangle all = { 0, 0, allocation.width, allocation.height };
+
+        if(icon_view->priv->backing)
+            cairo_surface_destroy(icon_view->priv->backing);
+
+        if(allocation.width <= 0 || allocation.height <= 0) {
+            icon_view->priv->backing = NULL;
+            return FALSE;
         }
+
+        icon_view->priv->backing = cairo_surface_create_similar(cairo_get_target(target_cr),
+                                                                CAIRO_CONTENT_COLOR_ALPHA,
+                                                                allocation.width,
+                                                                allocation.height);
+        icon_view->priv->backing_width = allocation.width;
+        icon_view->priv->backing_height = allocation.height;
+
+        if(icon_view->priv->backing_damage)
+            gdk_region_destroy(icon_view->priv->backing_damage);
+        icon_view->priv->backing_damage = gdk_region_rectangle(&all);
+    }
+
+    update = gdk_region_copy(area);
+    gdk_region_intersect(update, icon_view->priv->backing_damage);
+    if(gdk_region_empty(update)) {
+        gdk_region_destroy(update);
+        return TRUE;
     }
+    gdk_region_subtract(icon_view->priv->backing_damage, update);
+
+    cr = cairo_create(icon_view->priv->backing);
+    gdk_cairo_region(cr, update);
+    cairo_clip(cr);
+
+    cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+    gdk_cairo_set_source_pixmap(cr, icon_view->priv->background, 0, 0);
+    cairo_paint(cr);
+    cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
+
+    gdk_region_get_clipbox(update, &clipbox);
+    xfdesktop_icon_view_repaint_icons(icon_view, cr, &clipbox);
+
+    cairo_destroy(cr);
+    gdk_region_destroy(update);
+
+    return TRUE;
 }
 
 static inline gboolean
@@ -2736,6 +2993,9 @@ xfdesktop_setup_grids(XfdesktopIconView *icon_view)
     new_size = (guint)icon_view->priv->nrows * icon_view->priv->ncols
                * sizeof(XfdesktopIcon *);
 
+    /* the cells may have moved even if there are as many as before */
+    xfdesktop_icon_view_rebuild_index(icon_view);
+
     if(old_size == new_size) {
         DBG("old_size == new_size exiting");
         return;
@@ -2757,7 +3017,8 @@ xfdesktop_setup_grids(XfdesktopIconView *icon_view)
     
     XF_DEBUG("created grid_layout with %lu positions", (gulong)(new_size/sizeof(gpointer)));
     DUMP_GRID_LAYOUT(icon_view);
-    
+
+    xfdesktop_grid_reset_free_bits(icon_view);
     xfdesktop_icon_view_setup_grids_xinerama(icon_view);
 }
 
@@ -2773,6 +3034,7 @@ xfdesktop_rootwin_watch_workarea(GdkXEvent *gxevent,
        && XInternAtom(xevt->display, "_NET_WORKAREA", False) == xevt->atom)
     {
         XF_DEBUG("got _NET_WORKAREA change on rootwin!");
+        icon_view->priv->workarea_size_valid = FALSE;
         if(icon_view->priv->grid_resize_timeout) {
             g_source_remove(icon_view->priv->grid_resize_timeout);
             icon_view->priv->grid_resize_timeout = 0;
@@ -2783,6 +3045,122 @@ xfdesktop_rootwin_watch_workarea(GdkXEvent *gxevent,
     return GDK_FILTER_CONTINUE;
 }
 
+static gboolean
+xfdesktop_icon_view_flush_damage(gpointer user_data)
+{
+    XfdesktopIconView *icon_view = XFDESKTOP_ICON_VIEW(user_data);
+    GdkRegion *region;
+    gint i;
+
+    icon_view->priv->damage_flush_id = 0;
+
+    region = gdk_region_new();
+    for(i = 0; i < icon_view->priv->n_damage_rects; i++) {
+        GdkRectangle *rect = &icon_view->priv->damage_rects[i];
+
+        gdk_region_union_with_rect(region, rect);
+        icon_view->priv->damage_area_flushed += (guint64)rect->width * rect->height;
+    }
+    icon_view->priv->damage_rects_flushed += icon_view->priv->n_damage_rects;
+    icon_view->priv->n_damage_rects = 0;
+
+    if(gtk_widget_get_realized(GTK_WIDGET(icon_view))) {
+        gdk_window_invalidate_region(gtk_widget_get_window(GTK_WIDGET(icon_view)),
+                                     region, TRUE);
+    }
+    gdk_region_destroy(region);
+
+    return FALSE;
+}
+
+static inline gint64
+xfdesktop_rectangle_area(const GdkRectangle *rect)
+{
+    return (gint64)rect->width * rect->height;
+}
+
+/* Marks @area of the backing store as needing to be drawn again.  This
+ * doesn't invalidate anything on the window. */
+static void
+xfdesktop_icon_view_damage_backing(XfdesktopIconView *icon_view,
+                                   const GdkRectangle *area)
+{
+    if(icon_view->priv->backing_damage)
+        gdk_region_union_with_rect(icon_view->priv->backing_damage, area);
+}
+
+/* Throws the backing store away; the next expose makes a new one if
+ * there's still a background to use it with. */
+static void
+xfdesktop_icon_view_drop_backing(XfdesktopIconView *icon_view)
+{
+    if(icon_view->priv->backing) {
+        cairo_surface_destroy(icon_view->priv->backing);
+        icon_view->priv->backing = NULL;
+    }
+    if(icon_view->priv->backing_damage) {
+        gdk_region_destroy(icon_view->priv->backing_damage);
+        icon_view->priv->backing_damage = NULL;
+    }
+}
+
+static void
+xfdesktop_icon_view_invalidate_backing(XfdesktopIconView *icon_view)
+{
+    GdkRectangle all = { 0, 0,
+                         icon_view->priv->backing_width,
+                         icon_view->priv->backing_height };
+
+    xfdesktop_icon_view_damage_backing(icon_view, &all);
+}
+
+/* Queues @area for repainting.  It's merged into whichever pending
+ * rectangle it adds the least extra area to, or kept on its own if that
+ * would cost more and there's still room.  Everything gets flushed right
+ * before GDK's own redraw idle runs. */
+static void
+xfdesktop_icon_view_queue_damage(XfdesktopIconView *icon_view,
+                                 const GdkRectangle *area)
+{
+    GdkRectangle *rects = icon_view->priv->damage_rects;
+    GdkRectangle merged;
+    gint i, best = -1;
+    gint64 cost, best_cost = G_MAXINT64;
+
+    if(area->width <= 0 || area->height <= 0
+       || !gtk_widget_get_realized(GTK_WIDGET(icon_view)))
+    {
+        return;
+    }
+
+    icon_view->priv->damage_rects_submitted++;
+    xfdesktop_icon_view_damage_backing(icon_view, area);
+
+    for(i = 0; i < icon_view->priv->n_damage_rects; i++) {
+        gdk_rectangle_union(&rects[i], area, &merged);
+        cost = xfdesktop_rectangle_area(&merged)
+               - xfdesktop_rectangle_area(&rects[i])
+               - xfdesktop_rectangle_area(area);
+        if(cost < best_cost) {
+            best_cost = cost;
+            best = i;
+        }
+    }
+
+    if(best >= 0
+       && (best_cost <= 0 || icon_view->priv->n_damage_rects == DAMAGE_MAX_RECTS))
+    {
+        gdk_rectangle_union(&rects[best], area, &rects[best]);
+    } else
+        rects[icon_view->priv->n_damage_rects++] = *area;
+
+    if(!icon_view->priv->damage_flush_id) {
+        icon_view->priv->damage_flush_id = g_idle_add_full(GDK_PRIORITY_REDRAW - 1,
+                                                           xfdesktop_icon_view_flush_damage,
+                                                           icon_view, NULL);
+    }
+}
+
 static void
 xfdesktop_icon_view_invalidate_icon(XfdesktopIconView *icon_view,
                                     XfdesktopIcon *icon,
@@ -2797,11 +3175,7 @@ xfdesktop_icon_view_invalidate_icon(XfdesktopIconView *icon_view,
 
     /* we always have to invalidate the old extents */
     if(xfdesktop_icon_get_extents(icon, NULL, NULL, &extents)) {
-        if(gtk_widget_get_realized(GTK_WIDGET(icon_view))) {
-            gtk_widget_queue_draw_area(GTK_WIDGET(icon_view), extents.x,
-                                       extents.y, extents.width,
-                                       extents.height);
-        }
+        xfdesktop_icon_view_queue_damage(icon_view, &extents);
         invalidated_something = TRUE;
     } else
         recalc_extents = TRUE;
@@ -2817,9 +3191,7 @@ xfdesktop_icon_view_invalidate_icon(XfdesktopIconView *icon_view,
         {
             g_warning("Trying to invalidate icon, but can't recalculate extents");
         } else if(gtk_widget_get_realized(GTK_WIDGET(icon_view))) {
-            gtk_widget_queue_draw_area(GTK_WIDGET(icon_view),
-                                       total_extents.x, total_extents.y,
-                                       total_extents.width, total_extents.height);
+            xfdesktop_icon_view_queue_damage(icon_view, &total_extents);
             invalidated_something = TRUE;
         }
     }
@@ -2849,71 +3221,61 @@ xfdesktop_icon_view_invalidate_icon_pixbuf(XfdesktopIconView *icon_view,
         rect.x += CELL_PADDING + ((CELL_SIZE - 2 * CELL_PADDING) - rect.width) / 2;
         rect.y += CELL_PADDING + (ICON_SIZE - rect.height) / 2;;
     
-        if(gtk_widget_get_realized(GTK_WIDGET(icon_view))) {
-            gtk_widget_queue_draw_area(GTK_WIDGET(icon_view), rect.x, rect.y,
-                                       rect.width, rect.height);
-        }
+        xfdesktop_icon_view_queue_damage(icon_view, &rect);
     }
 }
 
 static void
 xfdesktop_paint_rounded_box(XfdesktopIconView *icon_view,
+                            cairo_t *cr,
                             GtkStateType state,
-                            GdkRectangle *box_area,
-                            GdkRectangle *expose_area)
+                            GdkRectangle *box_area)
 {
-    GdkRectangle intersection;
-    
-    if(gdk_rectangle_intersect(box_area, expose_area, &intersection)) {
-        cairo_t *cr = gdk_cairo_create(gtk_widget_get_window(GTK_WIDGET(icon_view)));
-        GtkStyle *style = gtk_widget_get_style(GTK_WIDGET(icon_view));
-        double alpha;
+    GtkStyle *style = gtk_widget_get_style(GTK_WIDGET(icon_view));
+    double alpha;
 
-        if(state == GTK_STATE_NORMAL)
-            alpha = icon_view->priv->label_alpha / 255.;
-        else
-            alpha = icon_view->priv->selected_label_alpha / 255.;
+    if(state == GTK_STATE_NORMAL)
+        alpha = icon_view->priv->label_alpha / 255.;
+    else
+        alpha = icon_view->priv->selected_label_alpha / 255.;
 
-        cairo_set_source_rgba(cr, style->base[state].red / 65535.,
-                              style->base[state].green / 65535.,
-                              style->base[state].blue / 65535.,
-                              alpha);
+    cairo_save(cr);
 
-        /* restrict painting to expose area */
-        gdk_cairo_rectangle(cr, expose_area);
-        cairo_clip(cr);
+    cairo_set_source_rgba(cr, style->base[state].red / 65535.,
+                          style->base[state].green / 65535.,
+                          style->base[state].blue / 65535.,
+                          alpha);
 
-        if(LABEL_RADIUS < 0.1)
-            gdk_cairo_rectangle(cr, box_area);
-        else {
-            cairo_move_to(cr, box_area->x, box_area->y + LABEL_RADIUS);
-            cairo_arc(cr, box_area->x + LABEL_RADIUS,
-                      box_area->y + LABEL_RADIUS, LABEL_RADIUS,
-                      M_PI, 3.0*M_PI/2.0);
-            cairo_line_to(cr, box_area->x + box_area->width - LABEL_RADIUS,
-                          box_area->y);
-            cairo_arc(cr, box_area->x + box_area->width - LABEL_RADIUS,
-                      box_area->y + LABEL_RADIUS, LABEL_RADIUS,
-                      3.0+M_PI/2.0, 0.0);
-            cairo_line_to(cr, box_area->x + box_area->width,
-                          box_area->y + box_area->height - LABEL_RADIUS);
-            cairo_arc(cr, box_area->x + box_area->width - LABEL_RADIUS,
-                      box_area->y + box_area->height - LABEL_RADIUS,
-                      LABEL_RADIUS,
-                      0.0, M_PI/2.0);
-            cairo_line_to(cr, box_area->x + LABEL_RADIUS,
-                          box_area->y + box_area->height);
-            cairo_arc(cr, box_area->x + LABEL_RADIUS,
-                      box_area->y + box_area->height - LABEL_RADIUS,
-                      LABEL_RADIUS,
-                      M_PI/2.0, M_PI);
-            cairo_close_path(cr);
-        }
+    if(LABEL_RADIUS < 0.1)
+        gdk_cairo_rectangle(cr, box_area);
+    else {
+        cairo_move_to(cr, box_area->x, box_area->y + LABEL_RADIUS);
+        cairo_arc(cr, box_area->x + LABEL_RADIUS,
+                  box_area->y + LABEL_RADIUS, LABEL_RADIUS,
+                  M_PI, 3.0*M_PI/2.0);
+        cairo_line_to(cr, box_area->x + box_area->width - LABEL_RADIUS,
+                      box_area->y);
+        cairo_arc(cr, box_area->x + box_area->width - LABEL_RADIUS,
+                  box_area->y + LABEL_RADIUS, LABEL_RADIUS,
+                  3.0+M_PI/2.0, 0.0);
+        cairo_line_to(cr, box_area->x + box_area->width,
+                      box_area->y + box_area->height - LABEL_RADIUS);
+        cairo_arc(cr, box_area->x + box_area->width - LABEL_RADIUS,
+                  box_area->y + box_area->height - LABEL_RADIUS,
+                  LABEL_RADIUS,
+                  0.0, M_PI/2.0);
+        cairo_line_to(cr, box_area->x + LABEL_RADIUS,
+                      box_area->y + box_area->height);
+        cairo_arc(cr, box_area->x + LABEL_RADIUS,
+                  box_area->y + box_area->height - LABEL_RADIUS,
+                  LABEL_RADIUS,
+                  M_PI/2.0, M_PI);
+        cairo_close_path(cr);
+    }
 
-        cairo_fill(cr);
+    cairo_fill(cr);
 
-        cairo_destroy(cr);
-    }
+    cairo_restore(cr);
 }
 
 static gboolean
@@ -2944,30 +3306,134 @@ xfdesktop_icon_view_calculate_icon_pixbuf_area(XfdesktopIconView *icon_view,
 }
 
 static void
-xfdesktop_icon_view_setup_pango_layout(XfdesktopIconView *icon_view,
-                                       XfdesktopIcon *icon,
-                                       PangoLayout *playout)
+xfdesktop_icon_label_cache_free(XfdesktopIconLabelCache *cache)
 {
-    const gchar *label = xfdesktop_icon_peek_label(icon);
+    guint i;
+
+    for(i = 0; i < G_N_ELEMENTS(cache->layouts); i++) {
+        if(cache->layouts[i].playout)
+            g_object_unref(G_OBJECT(cache->layouts[i].playout));
+        if(cache->layouts[i].shadow_mask)
+            cairo_surface_destroy(cache->layouts[i].shadow_mask);
+        g_free(cache->layouts[i].label);
+    }
 
-    g_return_if_fail(XFDESKTOP_IS_ICON_VIEW(icon_view)
-                     && XFDESKTOP_IS_ICON(icon));
+    g_slice_free(XfdesktopIconLabelCache, cache);
+}
 
-    pango_layout_set_ellipsize(playout, PANGO_ELLIPSIZE_NONE);
-    pango_layout_set_wrap(playout, PANGO_WRAP_WORD_CHAR);
-    pango_layout_set_width(playout, TEXT_WIDTH * PANGO_SCALE);
-    if (icon_view->priv->center_text)
-        pango_layout_set_alignment(playout, PANGO_ALIGN_CENTER);
-    else
-        pango_layout_set_alignment(playout, PANGO_ALIGN_LEFT);
-    pango_layout_set_text(playout, label, -1);
+static void
+xfdesktop_icon_view_invalidate_label_cache(XfdesktopIconView *icon_view)
+{
+    GList *l;
+
+    for(l = icon_view->priv->icons; l; l = l->next)
+        g_object_set_qdata(G_OBJECT(l->data), xfdesktop_label_cache_quark, NULL);
+    for(l = icon_view->priv->pending_icons; l; l = l->next)
+        g_object_set_qdata(G_OBJECT(l->data), xfdesktop_label_cache_quark, NULL);
+}
+
+/* Returns the layout for @icon's label in its current state, only shaping
+ * it again if the label or the way it's laid out changed since last time. */
+static XfdesktopIconLabelLayout *
+xfdesktop_icon_view_get_icon_layout(XfdesktopIconView *icon_view,
+                                    XfdesktopIcon *icon)
+{
+    XfdesktopIconLabelCache *cache;
+    XfdesktopIconLabelLayout *layout;
+    const gchar *label = xfdesktop_icon_peek_label(icon);
+    gboolean ellipsize;
+    gint width, height;
+    PangoAlignment alignment;
+
+    ellipsize = (!xfdesktop_icon_view_is_icon_selected(icon_view, icon)
+                 && icon_view->priv->ellipsize_icon_labels);
+    width = TEXT_WIDTH * PANGO_SCALE;
+    height = ellipsize ? TEXT_HEIGHT * PANGO_SCALE : -1;
+    alignment = icon_view->priv->center_text ? PANGO_ALIGN_CENTER : PANGO_ALIGN_LEFT;
+
+    cache = g_object_get_qdata(G_OBJECT(icon), xfdesktop_label_cache_quark);
+    if(!cache) {
+        cache = g_slice_new0(XfdesktopIconLabelCache);
+        g_object_set_qdata_full(G_OBJECT(icon), xfdesktop_label_cache_quark,
+                                cache,
+                                (GDestroyNotify)xfdesktop_icon_label_cache_free);
+    }
+
+    layout = &cache->layouts[ellipsize ? 1 : 0];
+
+    if(!layout->playout) {
+        layout->playout = pango_layout_new(gtk_widget_get_pango_context(GTK_WIDGET(icon_view)));
+        /* the shared layout carries the font */
+        pango_layout_set_font_description(layout->playout,
+                                          pango_layout_get_font_description(icon_view->priv->playout));
+        pango_layout_set_wrap(layout->playout, PANGO_WRAP_WORD_CHAR);
+        pango_layout_set_ellipsize(layout->playout,
+                                   ellipsize ? PANGO_ELLIPSIZE_END : PANGO_ELLIPSIZE_NONE);
+    } else if(layout->width == width && layout->height == height
+              && layout->alignment == alignment
+              && g_strcmp0(layout->label, label) == 0)
+    {
+        return layout;
+    }
 
-    if(!xfdesktop_icon_view_is_icon_selected(icon_view, icon)
-       && icon_view->priv->ellipsize_icon_labels) {
-        /* constrain the text area */
-        pango_layout_set_height(playout, TEXT_HEIGHT * PANGO_SCALE);
-        pango_layout_set_ellipsize(playout, PANGO_ELLIPSIZE_END);
+    pango_layout_set_width(layout->playout, width);
+    pango_layout_set_height(layout->playout, height);
+    pango_layout_set_alignment(layout->playout, alignment);
+    pango_layout_set_text(layout->playout, label, -1);
+
+    g_free(layout->label);
+    layout->label = g_strdup(label);
+    layout->width = width;
+    layout->height = height;
+    layout->alignment = alignment;
+    pango_layout_get_pixel_extents(layout->playout, NULL, &layout->extents);
+
+    if(layout->shadow_mask) {
+        cairo_surface_destroy(layout->shadow_mask);
+        layout->shadow_mask = NULL;
     }
+
+    return layout;
+}
+
+/* Returns the blurred shadow mask for @layout, creating it if there isn't
+ * one for the current blur radius yet. */
+static cairo_surface_t *
+xfdesktop_icon_view_get_shadow_mask(XfdesktopIconView *icon_view,
+                                    XfdesktopIconLabelLayout *layout)
+{
+    gint blur_radius = icon_view->priv->shadow_blur_radius;
+    gint pad;
+    cairo_t *cr;
+
+    if(layout->shadow_mask && layout->shadow_blur_radius == blur_radius)
+        return layout->shadow_mask;
+
+    if(layout->shadow_mask)
+        cairo_surface_destroy(layout->shadow_mask);
+
+    /* room for the blur, plus the outline stroked around the glyphs */
+    pad = _gtk_cairo_blur_compute_pixels(blur_radius) + 1;
+
+    layout->shadow_mask = cairo_image_surface_create(CAIRO_FORMAT_A8,
+                                                     layout->extents.width + 2 * pad,
+                                                     layout->extents.height + 2 * pad);
+    cairo_surface_set_device_offset(layout->shadow_mask,
+                                    pad - layout->extents.x,
+                                    pad - layout->extents.y);
+    layout->shadow_blur_radius = blur_radius;
+
+    cr = cairo_create(layout->shadow_mask);
+    pango_cairo_show_layout(cr, layout->playout);
+    cairo_set_line_width(cr, 1);
+    cairo_set_line_join(cr, CAIRO_LINE_JOIN_BEVEL);
+    pango_cairo_layout_path(cr, layout->playout);
+    cairo_stroke(cr);
+    cairo_destroy(cr);
+
+    _gtk_cairo_blur_surface(layout->shadow_mask, blur_radius);
+
+    return layout->shadow_mask;
 }
 
 static gboolean
@@ -2975,16 +3441,13 @@ xfdesktop_icon_view_calculate_icon_text_area(XfdesktopIconView *icon_view,
                                              XfdesktopIcon *icon,
                                              GdkRectangle *text_area)
 {
-    PangoLayout *playout;
     PangoRectangle prect;
 
     g_return_val_if_fail(XFDESKTOP_IS_ICON_VIEW(icon_view)
                          && XFDESKTOP_IS_ICON(icon)
                          && text_area, FALSE);
 
-    playout = icon_view->priv->playout;
-    xfdesktop_icon_view_setup_pango_layout(icon_view, icon, playout);
-    pango_layout_get_pixel_extents(playout, NULL, &prect);
+    prect = xfdesktop_icon_view_get_icon_layout(icon_view, icon)->extents;
 
     text_area->x = prect.x - SHADOW_X_OFFSET;
     text_area->y = prect.y - SHADOW_Y_OFFSET;
@@ -3060,6 +3523,7 @@ xfdesktop_icon_view_update_icon_extents(XfdesktopIconView *icon_view,
     gdk_rectangle_union(pixbuf_extents, box_extents, total_extents);
 
     xfdesktop_icon_set_extents(icon, pixbuf_extents, text_extents, total_extents);
+    xfdesktop_icon_view_index_icon(icon_view, icon);
 
     return TRUE;
 }
@@ -3078,29 +3542,23 @@ xfdesktop_icon_view_draw_image(cairo_t *cr, GdkPixbuf *pix, GdkRectangle *rect)
 static void
 xfdesktop_icon_view_draw_text(cairo_t *cr, PangoLayout *playout, GdkRectangle *text_area,
                               GdkRectangle *box_area, gint x_offset, gint y_offset,
-                              gint blur_radius, GdkColor *color)
+                              cairo_surface_t *shadow_mask, GdkColor *color)
 {
     cairo_save(cr);
 
-    /*  Clip the cairo area to blur the minimum surface */
     gdk_cairo_rectangle(cr, box_area);
     cairo_clip(cr);
 
-    cairo_move_to(cr,
-                  text_area->x + x_offset,
-                  text_area->y + y_offset);
+    gdk_cairo_set_source_color(cr, color);
 
-    if (blur_radius > 1) {
-        cr = gtk_css_shadow_value_start_drawing (cr, blur_radius);
-        pango_cairo_show_layout (cr, playout);
-        cairo_set_line_width(cr, 1);
-        cairo_set_line_join(cr, CAIRO_LINE_JOIN_BEVEL);
-        pango_cairo_layout_path(cr, playout);
-        cairo_stroke(cr);
-        cr = gtk_css_shadow_value_finish_drawing (cr, blur_radius, color);
-    }
-    else {
-        gdk_cairo_set_source_color(cr, color);
+    if(shadow_mask) {
+        cairo_mask_surface(cr, shadow_mask,
+                           text_area->x + x_offset,
+                           text_area->y + y_offset);
+    } else {
+        cairo_move_to(cr,
+                      text_area->x + x_offset,
+                      text_area->y + y_offset);
         pango_cairo_show_layout(cr, playout);
     }
 
@@ -3108,90 +3566,85 @@ xfdesktop_icon_view_draw_text(cairo_t *cr, PangoLayout *playout, GdkRectangle *t
 }
 
 static void
-xfdesktop_icon_view_paint_icon(XfdesktopIconView *icon_view,
-                               XfdesktopIcon *icon,
-                               GdkRectangle *area)
+xfdesktop_icon_view_invalidate_cached_surfaces(XfdesktopIconView *icon_view)
+{
+    GList *l;
+
+    for(l = icon_view->priv->icons; l; l = l->next)
+        xfdesktop_icon_invalidate_cached_surfaces(XFDESKTOP_ICON(l->data));
+    for(l = icon_view->priv->pending_icons; l; l = l->next)
+        xfdesktop_icon_invalidate_cached_surfaces(XFDESKTOP_ICON(l->data));
+
+    /* every icon may look different now */
+    xfdesktop_icon_view_invalidate_backing(icon_view);
+}
+
+static XfdesktopIconDrawState
+xfdesktop_icon_view_get_draw_state(XfdesktopIconView *icon_view,
+                                   XfdesktopIcon *icon,
+                                   GtkStateType *state)
+{
+    XfdesktopIconDrawState draw_state;
+
+    if(xfdesktop_icon_view_is_icon_selected(icon_view, icon)) {
+        if(gtk_widget_has_focus(GTK_WIDGET(icon_view))) {
+            *state = GTK_STATE_SELECTED;
+            draw_state = XFDESKTOP_ICON_DRAW_SELECTED;
+        } else {
+            *state = GTK_STATE_ACTIVE;
+            draw_state = XFDESKTOP_ICON_DRAW_ACTIVE;
+        }
+    } else {
+        *state = GTK_STATE_NORMAL;
+        draw_state = XFDESKTOP_ICON_DRAW_NORMAL;
+    }
+
+    if(icon_view->priv->item_under_pointer == icon)
+        draw_state += XFDESKTOP_ICON_DRAW_NORMAL_HOVERED;
+
+    return draw_state;
+}
+
+/* Draws everything that makes up @icon in @state into a new surface
+ * covering @total_extents, so the icon doesn't need to be colorized,
+ * spotlighted and have its label shadow blurred on every expose. */
+static cairo_surface_t *
+xfdesktop_icon_view_render_icon(XfdesktopIconView *icon_view,
+                                XfdesktopIcon *icon,
+                                cairo_t *target_cr,
+                                GtkStateType state,
+                                XfdesktopIconDrawState draw_state,
+                                GdkRectangle *pixbuf_extents,
+                                GdkRectangle *text_extents,
+                                GdkRectangle *box_extents,
+                                GdkRectangle *total_extents)
 {
     GtkWidget *widget = GTK_WIDGET(icon_view);
-    PangoLayout *playout;
-    GdkRectangle pixbuf_extents, text_extents, box_extents, total_extents;
-    GdkRectangle intersection;
-    gint state;
+    GtkStyle *style = gtk_widget_get_style(widget);
+    XfdesktopIconLabelLayout *layout = xfdesktop_icon_view_get_icon_layout(icon_view,
+                                                                           icon);
+    GdkPixbuf *pix;
+    cairo_surface_t *surface;
+    cairo_t *cr;
     gchar x_offset = 0, y_offset = 0;
     GdkColor *sh_text_col = NULL;
-    cairo_t *cr;
-#ifdef G_ENABLE_DEBUG
-    gint16 row, col;
-#endif
 
-    TRACE("entering, (%s)(area=%dx%d+%d+%d)", xfdesktop_icon_peek_label(icon),
-          area->width, area->height, area->x, area->y);
+    /* similar to the window, so blitting it later doesn't need to go
+     * through client memory */
+    surface = cairo_surface_create_similar(cairo_get_target(target_cr),
+                                           CAIRO_CONTENT_COLOR_ALPHA,
+                                           MAX(total_extents->width, 1),
+                                           MAX(total_extents->height, 1));
+    cr = cairo_create(surface);
+    cairo_translate(cr, -total_extents->x, -total_extents->y);
 
-    playout = icon_view->priv->playout;
+    pix = xfdesktop_icon_peek_state_pixbuf(icon, ICON_WIDTH, ICON_SIZE,
+                                           draw_state, &style->base[state]);
+    if(pix)
+        xfdesktop_icon_view_draw_image(cr, pix, pixbuf_extents);
 
-    cr = gdk_cairo_create(GDK_DRAWABLE(gtk_widget_get_window(widget)));
-    
-    if(!xfdesktop_icon_get_extents(icon, &pixbuf_extents,
-                                   &text_extents, &total_extents))
-    {
-        g_warning("Can't get extents for icon '%s'", xfdesktop_icon_peek_label(icon));
-    }
-
-    if(!xfdesktop_icon_view_update_icon_extents(icon_view, icon,
-                                                &pixbuf_extents,
-                                                &text_extents,
-                                                &box_extents,
-                                                &total_extents))
-    {
-        g_warning("Can't update extents for icon '%s'",
-                  xfdesktop_icon_peek_label(icon));
-    }
-
-    if(xfdesktop_icon_view_is_icon_selected(icon_view, icon)) {
-        if(gtk_widget_has_focus(widget))
-            state = GTK_STATE_SELECTED;
-        else
-            state = GTK_STATE_ACTIVE;
-    } else
-        state = GTK_STATE_NORMAL;
-    
-    if(gdk_rectangle_intersect(area, &pixbuf_extents, &intersection)) {
-        GdkPixbuf *pix = xfdesktop_icon_peek_pixbuf(icon, ICON_WIDTH, ICON_SIZE);
-        GdkPixbuf *pix_free = NULL;
-
-        if(state != GTK_STATE_NORMAL) {
-            pix_free = exo_gdk_pixbuf_colorize(pix, &gtk_widget_get_style(widget)->base[state]);
-            pix = pix_free;
-        }
-
-        if(icon_view->priv->item_under_pointer == icon) {
-            GdkPixbuf *tmp = exo_gdk_pixbuf_spotlight(pix);
-            if(pix_free)
-                g_object_unref(G_OBJECT(pix_free));
-            pix = tmp;
-            pix_free = tmp;
-        }
-
-#ifdef G_ENABLE_DEBUG
-        xfdesktop_icon_get_position(icon, &row, &col);
-
-        TRACE("painting pixbuf at %dx%d+%d+%d (row %d ,col %d)",
-              pixbuf_extents.width, pixbuf_extents.height,
-              pixbuf_extents.x, pixbuf_extents.y,
-              row, col);
-#endif
-
-        xfdesktop_icon_view_draw_image(cr, pix, &pixbuf_extents);
-        
-        if(pix_free)
-            g_object_unref(G_OBJECT(pix_free));
-    }
-
-    /* Only redraw the text if the text area requires it. */
-    if(gdk_rectangle_intersect(area, &box_extents, &intersection)
-       && icon_view->priv->font_size > 0)
-    {
-        xfdesktop_paint_rounded_box(icon_view, state, &box_extents, area);
+    if(icon_view->priv->font_size > 0) {
+        xfdesktop_paint_rounded_box(icon_view, cr, state, box_extents);
 
         if (state == GTK_STATE_NORMAL) {
             x_offset = icon_view->priv->shadow_x_offset;
@@ -3206,24 +3659,94 @@ xfdesktop_icon_view_paint_icon(XfdesktopIconView *icon_view,
         /* draw text shadow for the label text if an offset was defined */
         if(x_offset || y_offset || (icon_view->priv->shadow_blur_radius > 1)) {
             /* Draw the shadow */
-            xfdesktop_icon_view_draw_text(cr, playout,
-                                          &text_extents,
-                                          &box_extents,
+            cairo_surface_t *shadow_mask = NULL;
+
+            if(icon_view->priv->shadow_blur_radius > 1)
+                shadow_mask = xfdesktop_icon_view_get_shadow_mask(icon_view, layout);
+
+            xfdesktop_icon_view_draw_text(cr, layout->playout,
+                                          text_extents,
+                                          box_extents,
                                           x_offset,
                                           y_offset,
-                                          icon_view->priv->shadow_blur_radius,
+                                          shadow_mask,
                                           sh_text_col);
         }
 
-        TRACE("painting text at %dx%d+%d+%d",
-              text_extents.width, text_extents.height,
-              text_extents.x, text_extents.y);
+        /* gtk_paint_layout() can only draw to a GdkDrawable, so do what
+         * the default style does for it */
+        xfdesktop_icon_view_draw_text(cr, layout->playout, text_extents,
+                                      box_extents, 0, 0, NULL,
+                                      &style->fg[state]);
+    }
+
+    cairo_destroy(cr);
+
+    return surface;
+}
+
+static void
+xfdesktop_icon_view_paint_icon(XfdesktopIconView *icon_view,
+                               XfdesktopIcon *icon,
+                               cairo_t *cr,
+                               GdkRectangle *area)
+{
+    GdkRectangle pixbuf_extents, text_extents, box_extents, total_extents;
+    GdkRectangle cell = { 0, }, surface_area;
+    GtkStateType state;
+    XfdesktopIconDrawState draw_state;
+    cairo_surface_t *surface;
+
+    TRACE("entering, (%s)(area=%dx%d+%d+%d)", xfdesktop_icon_peek_label(icon),
+          area->width, area->height, area->x, area->y);
+
+    if(!xfdesktop_icon_get_extents(icon, &pixbuf_extents,
+                                   &text_extents, &total_extents))
+    {
+        g_warning("Can't get extents for icon '%s'", xfdesktop_icon_peek_label(icon));
+    }
 
-        gtk_paint_layout(gtk_widget_get_style(widget), gtk_widget_get_window(widget),
-                         state, FALSE, area, widget, "label",
-                         text_extents.x, text_extents.y, playout);
+    if(!xfdesktop_icon_view_update_icon_extents(icon_view, icon,
+                                                &pixbuf_extents,
+                                                &text_extents,
+                                                &box_extents,
+                                                &total_extents)
+       || !xfdesktop_icon_view_shift_area_to_cell(icon_view, icon, &cell))
+    {
+        g_warning("Can't update extents for icon '%s'",
+                  xfdesktop_icon_peek_label(icon));
+        return;
     }
 
+    draw_state = xfdesktop_icon_view_get_draw_state(icon_view, icon, &state);
+
+    surface = xfdesktop_icon_peek_cached_surface(icon, draw_state, &surface_area);
+    if(!surface) {
+        TRACE("rendering icon at %dx%d+%d+%d",
+              total_extents.width, total_extents.height,
+              total_extents.x, total_extents.y);
+
+        surface = xfdesktop_icon_view_render_icon(icon_view, icon, cr, state,
+                                                  draw_state,
+                                                  &pixbuf_extents,
+                                                  &text_extents,
+                                                  &box_extents,
+                                                  &total_extents);
+
+        surface_area = total_extents;
+        surface_area.x -= cell.x;
+        surface_area.y -= cell.y;
+        xfdesktop_icon_set_cached_surface(icon, draw_state, surface,
+                                          &surface_area);
+    }
+
+    cairo_save(cr);
+    gdk_cairo_rectangle(cr, area);
+    cairo_clip(cr);
+    cairo_set_source_surface(cr, surface,
+                             cell.x + surface_area.x,
+                             cell.y + surface_area.y);
+    cairo_paint(cr);
 
 #if 0 /*def DEBUG*/
     {
@@ -3267,7 +3790,7 @@ xfdesktop_icon_view_paint_icon(XfdesktopIconView *icon_view,
     }
 #endif
 
-    cairo_destroy(cr);
+    cairo_restore(cr);
 }
 
 static void
@@ -3285,6 +3808,7 @@ xfdesktop_move_all_icons_to_pending_icons_list(XfdesktopIconView *icon_view)
         g_signal_handlers_disconnect_by_func(G_OBJECT(l->data),
                                              G_CALLBACK(xfdesktop_icon_view_icon_changed),
                                              icon_view);
+        xfdesktop_icon_view_unindex_icon(icon_view, XFDESKTOP_ICON(l->data));
     }
     icon_view->priv->pending_icons = g_list_concat(icon_view->priv->icons,
                                                    icon_view->priv->pending_icons);
@@ -3293,6 +3817,7 @@ xfdesktop_move_all_icons_to_pending_icons_list(XfdesktopIconView *icon_view)
     memset(icon_view->priv->grid_layout, 0,
            (guint)icon_view->priv->nrows * icon_view->priv->ncols
            * sizeof(XfdesktopIcon *));
+    xfdesktop_grid_reset_free_bits(icon_view);
     
     xfdesktop_setup_grids(icon_view);
 }
@@ -3476,6 +4001,7 @@ xfdesktop_grid_do_resize(XfdesktopIconView *icon_view)
         xfdesktop_setup_grids (icon_view);
     }
 
+    xfdesktop_icon_view_invalidate_backing(icon_view);
     gtk_widget_queue_draw(GTK_WIDGET(icon_view));
 }
 
@@ -3571,6 +4097,30 @@ xfdesktop_get_workarea_single(XfdesktopIconView *icon_view,
     return ret;
 }
 
+/* Like xfdesktop_get_workarea_single() for the first workspace, but the
+ * X server is only asked again once the work area may have changed.  Both
+ * are 0 if the window manager doesn't set one. */
+void
+xfdesktop_icon_view_get_workarea_size(XfdesktopIconView *icon_view,
+                                      gint *width,
+                                      gint *height)
+{
+    gint xorigin = 0, yorigin = 0, w = 0, h = 0;
+
+    g_return_if_fail(XFDESKTOP_IS_ICON_VIEW(icon_view) && width && height);
+
+    if(!icon_view->priv->workarea_size_valid) {
+        xfdesktop_get_workarea_single(icon_view, 0, &xorigin, &yorigin, &w, &h);
+        icon_view->priv->workarea_width = w;
+        icon_view->priv->workarea_height = h;
+        /* changes are only watched for while we're realized */
+        icon_view->priv->workarea_size_valid = gtk_widget_get_realized(GTK_WIDGET(icon_view));
+    }
+
+    *width = icon_view->priv->workarea_width;
+    *height = icon_view->priv->workarea_height;
+}
+
 static inline gboolean
 xfdesktop_grid_is_free_position(XfdesktopIconView *icon_view,
                                 gint16 row,
@@ -3588,23 +4138,58 @@ xfdesktop_grid_is_free_position(XfdesktopIconView *icon_view,
 }
 
 
+/* Sets up grid_free_bits from scratch to match grid_layout */
+static void
+xfdesktop_grid_reset_free_bits(XfdesktopIconView *icon_view)
+{
+    gint i, n_cells, n_words;
+
+    n_cells = (gint)icon_view->priv->nrows * icon_view->priv->ncols;
+    n_words = (n_cells + GRID_BITS_PER_WORD - 1) / GRID_BITS_PER_WORD;
+
+    g_free(icon_view->priv->grid_free_bits);
+    icon_view->priv->grid_free_bits = g_new0(gulong, MAX(n_words, 1));
+    icon_view->priv->grid_free_first_word = 0;
+    icon_view->priv->grid_n_free = 0;
+
+    if(!icon_view->priv->grid_layout)
+        return;
+
+    for(i = 0; i < n_cells; i++) {
+        if(!icon_view->priv->grid_layout[i]) {
+            icon_view->priv->grid_free_bits[i / GRID_BITS_PER_WORD]
+                |= 1UL << (i % GRID_BITS_PER_WORD);
+            icon_view->priv->grid_n_free++;
+        }
+    }
+}
+
 static gboolean
 xfdesktop_grid_get_next_free_position(XfdesktopIconView *icon_view,
                                       gint16 *row,
                                       gint16 *col)
 {
-    gint i, maxi;
+    gint i, n_words, idx;
     
     g_return_val_if_fail(row && col, FALSE);
+
+    if(!icon_view->priv->grid_free_bits || icon_view->priv->grid_n_free <= 0)
+        return FALSE;
     
-    maxi = icon_view->priv->nrows * icon_view->priv->ncols;
-    for(i = 0; i < maxi; ++i) {
-        if(!icon_view->priv->grid_layout[i]) {
-            *row = i % icon_view->priv->nrows;
-            *col = i / icon_view->priv->nrows;
+    n_words = ((gint)icon_view->priv->nrows * icon_view->priv->ncols
+               + GRID_BITS_PER_WORD - 1) / GRID_BITS_PER_WORD;
+    for(i = icon_view->priv->grid_free_first_word; i < n_words; ++i) {
+        gulong word = icon_view->priv->grid_free_bits[i];
+
+        if(word) {
+            icon_view->priv->grid_free_first_word = i;
+            idx = i * GRID_BITS_PER_WORD + g_bit_nth_lsf(word, -1);
+            *row = idx % icon_view->priv->nrows;
+            *col = idx / icon_view->priv->nrows;
             return TRUE;
         }
     }
+    icon_view->priv->grid_free_first_word = n_words;
     
     return FALSE;
 }
@@ -3615,6 +4200,8 @@ xfdesktop_grid_set_position_free(XfdesktopIconView *icon_view,
                                  gint16 row,
                                  gint16 col)
 {
+    gint idx;
+
     g_return_if_fail(row < icon_view->priv->nrows
                      && col < icon_view->priv->ncols);
     
@@ -3622,7 +4209,15 @@ xfdesktop_grid_set_position_free(XfdesktopIconView *icon_view,
     DUMP_GRID_LAYOUT(icon_view);
 #endif
 
-    icon_view->priv->grid_layout[col * icon_view->priv->nrows + row] = NULL;
+    idx = col * icon_view->priv->nrows + row;
+    if(icon_view->priv->grid_layout[idx] && icon_view->priv->grid_free_bits) {
+        icon_view->priv->grid_free_bits[idx / GRID_BITS_PER_WORD]
+            |= 1UL << (idx % GRID_BITS_PER_WORD);
+        icon_view->priv->grid_n_free++;
+        icon_view->priv->grid_free_first_word = MIN(icon_view->priv->grid_free_first_word,
+                                                    idx / GRID_BITS_PER_WORD);
+    }
+    icon_view->priv->grid_layout[idx] = NULL;
 
 #if 0 /*def DEBUG*/
     DUMP_GRID_LAYOUT(icon_view);
@@ -3649,6 +4244,11 @@ xfdesktop_grid_unset_position_free_raw(XfdesktopIconView *icon_view,
 #endif
 
     icon_view->priv->grid_layout[idx] = data;
+    if(data && icon_view->priv->grid_free_bits) {
+        icon_view->priv->grid_free_bits[idx / GRID_BITS_PER_WORD]
+            &= ~(1UL << (idx % GRID_BITS_PER_WORD));
+        icon_view->priv->grid_n_free--;
+    }
 
 #if 0 /*def DEBUG*/
     DUMP_GRID_LAYOUT(icon_view);
@@ -3711,20 +4311,204 @@ xfdesktop_rectangle_contains_point(GdkRectangle *rect, gint x, gint y)
     return TRUE;
 }
 
-static gint
-xfdesktop_check_icon_clicked(gconstpointer data,
-                             gconstpointer user_data)
+/* Converts @rect into the range of grid cells it overlaps, as a rectangle
+ * of columns and rows.  Anything outside of the grid goes into the cells
+ * at its edge. */
+static gboolean
+xfdesktop_icon_view_rect_to_cells(XfdesktopIconView *icon_view,
+                                  const GdkRectangle *rect,
+                                  GdkRectangle *cells)
 {
-    XfdesktopIcon *icon = XFDESKTOP_ICON(data);
-    GdkEventButton *evt = (GdkEventButton *)user_data;
-    GdkRectangle extents;
-    
-    if(xfdesktop_icon_get_extents(icon, NULL, NULL, &extents)
-       && xfdesktop_rectangle_contains_point(&extents, evt->x, evt->y))
+    gint16 first_row, first_col, last_row, last_col;
+
+    if(icon_view->priv->nrows <= 0 || icon_view->priv->ncols <= 0
+       || rect->width <= 0 || rect->height <= 0)
     {
-        return 0;
-    } else
-        return 1;
+        return FALSE;
+    }
+
+    xfdesktop_xy_to_rowcol(icon_view, rect->x, rect->y,
+                           &first_row, &first_col);
+    xfdesktop_xy_to_rowcol(icon_view,
+                           rect->x + rect->width - 1,
+                           rect->y + rect->height - 1,
+                           &last_row, &last_col);
+
+    first_row = CLAMP(first_row, 0, icon_view->priv->nrows - 1);
+    first_col = CLAMP(first_col, 0, icon_view->priv->ncols - 1);
+    last_row = CLAMP(last_row, 0, icon_view->priv->nrows - 1);
+    last_col = CLAMP(last_col, 0, icon_view->priv->ncols - 1);
+
+    cells->x = first_col;
+    cells->y = first_row;
+    cells->width = last_col - first_col + 1;
+    cells->height = last_row - first_row + 1;
+
+    return TRUE;
+}
+
+static void
+xfdesktop_icon_view_unindex_icon(XfdesktopIconView *icon_view,
+                                 XfdesktopIcon *icon)
+{
+    GdkRectangle *cells;
+    gint row, col;
+
+    cells = g_hash_table_lookup(icon_view->priv->icon_index_cells, icon);
+    if(!cells)
+        return;
+
+    for(col = cells->x; col < cells->x + cells->width; col++) {
+        for(row = cells->y; row < cells->y + cells->height; row++) {
+            GSList **bucket = &icon_view->priv->icon_index[col * icon_view->priv->nrows + row];
+            *bucket = g_slist_remove(*bucket, icon);
+        }
+    }
+
+    g_hash_table_remove(icon_view->priv->icon_index_cells, icon);
+}
+
+/* Puts @icon into the cells its current total extents overlap */
+static void
+xfdesktop_icon_view_index_icon(XfdesktopIconView *icon_view,
+                               XfdesktopIcon *icon)
+{
+    GdkRectangle extents, cells, *old_cells;
+    gint row, col;
+
+    if(!icon_view->priv->icon_index
+       || !xfdesktop_icon_get_extents(icon, NULL, NULL, &extents)
+       || !xfdesktop_icon_view_rect_to_cells(icon_view, &extents, &cells))
+    {
+        xfdesktop_icon_view_unindex_icon(icon_view, icon);
+        return;
+    }
+
+    old_cells = g_hash_table_lookup(icon_view->priv->icon_index_cells, icon);
+    if(old_cells && xfdesktop_rectangle_equal(old_cells, &cells))
+        return;
+
+    xfdesktop_icon_view_unindex_icon(icon_view, icon);
+
+    for(col = cells.x; col < cells.x + cells.width; col++) {
+        for(row = cells.y; row < cells.y + cells.height; row++) {
+            GSList **bucket = &icon_view->priv->icon_index[col * icon_view->priv->nrows + row];
+            *bucket = g_slist_prepend(*bucket, icon);
+        }
+    }
+
+    g_hash_table_insert(icon_view->priv->icon_index_cells, icon,
+                        g_memdup(&cells, sizeof(cells)));
+}
+
+static void
+xfdesktop_icon_view_rebuild_index(XfdesktopIconView *icon_view)
+{
+    GdkRectangle pixbuf_extents, text_extents, box_extents, total_extents;
+    gint i, n_cells;
+    GList *l;
+
+    if(icon_view->priv->icon_index) {
+        for(i = 0; i < icon_view->priv->icon_index_size; i++)
+            g_slist_free(icon_view->priv->icon_index[i]);
+        g_free(icon_view->priv->icon_index);
+        icon_view->priv->icon_index = NULL;
+        icon_view->priv->icon_index_size = 0;
+    }
+    g_hash_table_remove_all(icon_view->priv->icon_index_cells);
+
+    n_cells = MAX(icon_view->priv->nrows, 0) * MAX(icon_view->priv->ncols, 0);
+    if(n_cells == 0)
+        return;
+
+    icon_view->priv->icon_index = g_new0(GSList *, n_cells);
+    icon_view->priv->icon_index_size = n_cells;
+
+    /* the extents depend on where the cells are, so they have to be
+     * worked out again too; that indexes the icons */
+    for(l = icon_view->priv->icons; l; l = l->next) {
+        xfdesktop_icon_view_update_icon_extents(icon_view, l->data,
+                                                &pixbuf_extents,
+                                                &text_extents,
+                                                &box_extents,
+                                                &total_extents);
+    }
+}
+
+/* Returns a new list of the icons whose total extents intersect @area */
+static GSList *
+xfdesktop_icon_view_icons_in_area(XfdesktopIconView *icon_view,
+                                  const GdkRectangle *area)
+{
+    GSList *icons = NULL, *l;
+    GdkRectangle cells, extents, *icon_cells;
+    gint row, col;
+
+    if(!icon_view->priv->icon_index
+       || !xfdesktop_icon_view_rect_to_cells(icon_view, area, &cells))
+    {
+        return NULL;
+    }
+
+    for(col = cells.x; col < cells.x + cells.width; col++) {
+        for(row = cells.y; row < cells.y + cells.height; row++) {
+            l = icon_view->priv->icon_index[col * icon_view->priv->nrows + row];
+            for(; l; l = l->next) {
+                XfdesktopIcon *icon = l->data;
+
+                /* icons spanning several cells are in all of them; only
+                 * look at each one in the first cell both ranges share */
+                icon_cells = g_hash_table_lookup(icon_view->priv->icon_index_cells,
+                                                 icon);
+                if(col != MAX(icon_cells->x, cells.x)
+                   || row != MAX(icon_cells->y, cells.y))
+                {
+                    continue;
+                }
+
+                if(xfdesktop_icon_get_extents(icon, NULL, NULL, &extents)
+                   && gdk_rectangle_intersect(&extents, area, NULL))
+                {
+                    icons = g_slist_prepend(icons, icon);
+                }
+            }
+        }
+    }
+
+    return icons;
+}
+
+static XfdesktopIcon *
+xfdesktop_icon_view_icon_at_point(XfdesktopIconView *icon_view,
+                                  gint x,
+                                  gint y)
+{
+    GdkRectangle point = { x, y, 1, 1 }, cells, extents;
+    GSList *l;
+
+    if(!icon_view->priv->icon_index
+       || !xfdesktop_icon_view_rect_to_cells(icon_view, &point, &cells))
+    {
+        return NULL;
+    }
+
+    l = icon_view->priv->icon_index[cells.x * icon_view->priv->nrows + cells.y];
+    for(; l; l = l->next) {
+        if(xfdesktop_icon_get_extents(l->data, NULL, NULL, &extents)
+           && xfdesktop_rectangle_contains_point(&extents, x, y))
+        {
+            return l->data;
+        }
+    }
+
+    return NULL;
+}
+
+static void
+xfdesktop_list_foreach_unset_selected(gpointer data,
+                                      gpointer user_data)
+{
+    xfdesktop_icon_set_is_selected(XFDESKTOP_ICON(data), FALSE);
 }
 
 static void
@@ -3752,6 +4536,7 @@ xfdesktop_icon_view_modify_font_size(XfdesktopIconView *icon_view,
     pango_font_description_set_size(pfd_new, (gint)(size * PANGO_SCALE));
     
     pango_layout_set_font_description(icon_view->priv->playout, pfd_new);
+    xfdesktop_icon_view_invalidate_label_cache(icon_view);
     
     pango_font_description_free(pfd_new);
 }
@@ -3760,6 +4545,8 @@ static void
 xfdesktop_icon_view_icon_changed(XfdesktopIcon *icon,
                                  gpointer user_data)
 {
+    xfdesktop_icon_invalidate_cached_surfaces(icon);
+
     /* maybe can pass FALSE here */
     xfdesktop_icon_view_invalidate_icon(XFDESKTOP_ICON_VIEW(user_data),
                                         icon, TRUE);
@@ -3769,7 +4556,7 @@ static gboolean
 xfdesktop_icon_view_is_icon_selected(XfdesktopIconView *icon_view,
                                      XfdesktopIcon *icon)
 {
-    return (g_list_find(icon_view->priv->selected_icons, icon)) == NULL ? FALSE : TRUE;
+    return xfdesktop_icon_get_is_selected(icon);
 }
 
 
@@ -3805,6 +4592,12 @@ xfdesktop_icon_view_new(XfdesktopIconViewManager *manager)
                            G_TYPE_DOUBLE,
                            G_OBJECT(icon_view),
                            "tooltip_size");
+
+    xfconf_g_property_bind(icon_view->priv->channel,
+                           "/desktop-icons/use-backing-store",
+                           G_TYPE_BOOLEAN,
+                           G_OBJECT(icon_view),
+                           "use_backing_store");
     
     return GTK_WIDGET(icon_view);
 }
@@ -3814,7 +4607,6 @@ xfdesktop_icon_view_add_item_internal(XfdesktopIconView *icon_view,
                                       XfdesktopIcon *icon)
 {
     gint16 row, col;
-    GdkRectangle fake_area;
     
     /* sanity check: at this point this should be taken care of */
     if(!xfdesktop_icon_get_position(icon, &row, &col)) {
@@ -3833,118 +4625,226 @@ xfdesktop_icon_view_add_item_internal(XfdesktopIconView *icon_view,
                      G_CALLBACK(xfdesktop_icon_view_icon_changed),
                      icon_view);
 
-    fake_area.x = icon_view->priv->xorigin + icon_view->priv->xmargin + col * CELL_SIZE + col * icon_view->priv->xspacing;
-    fake_area.y = icon_view->priv->yorigin + icon_view->priv->ymargin + row * CELL_SIZE + row * icon_view->priv->yspacing;
-    fake_area.width = fake_area.height = CELL_SIZE;
-    xfdesktop_icon_view_paint_icon(icon_view, icon, &fake_area);
+    /* works out the extents, which also puts the icon into the index,
+     * and gets it painted with the next frame */
+    xfdesktop_icon_view_invalidate_icon(icon_view, icon, TRUE);
 }
 
+/* Takes @icon into the icon view, returns FALSE if it can't be added */
 static gboolean
-xfdesktop_icon_view_icon_find_position(XfdesktopIconView *icon_view,
-                                       XfdesktopIcon *icon)
+xfdesktop_icon_view_adopt_item(XfdesktopIconView *icon_view,
+                               XfdesktopIcon *icon)
+{
+    g_return_val_if_fail(XFDESKTOP_IS_ICON(icon), FALSE);
+
+    /* ensure the icon isn't already in an icon view */
+    g_return_val_if_fail(!g_object_get_data(G_OBJECT(icon),
+                                            "--xfdesktop-icon-view"), FALSE);
+
+    g_object_set_data(G_OBJECT(icon), "--xfdesktop-icon-view", icon_view);
+    g_object_ref(G_OBJECT(icon));
+
+    return TRUE;
+}
+
+void
+xfdesktop_icon_view_add_item(XfdesktopIconView *icon_view,
+                             XfdesktopIcon *icon)
+{
+    xfdesktop_icon_view_add_items(icon_view, &icon, 1);
+}
+
+/**
+ * xfdesktop_icon_view_add_items:
+ * @icon_view: An #XfdesktopIconView.
+ * @icons: The icons to add.
+ * @n_icons: The number of icons in @icons.
+ *
+ * Adds all of @icons at once.  The icons whose position is still free get
+ * their cells first, then the rest are put into the free cells that are
+ * left, in order.  Icons that don't fit are kept until there is room.
+ * All of them are painted together with the next frame.
+ **/
+void
+xfdesktop_icon_view_add_items(XfdesktopIconView *icon_view,
+                              XfdesktopIcon **icons,
+                              guint n_icons)
 {
+    GList *unplaced = NULL, *overflow = NULL, *l;
     gint16 row, col;
-    
-    if(!xfdesktop_icon_get_position(icon, &row, &col)
-       || !xfdesktop_grid_is_free_position(icon_view, row, col))
-    {
+    guint i;
+
+    g_return_if_fail(XFDESKTOP_IS_ICON_VIEW(icon_view));
+    g_return_if_fail(icons != NULL || n_icons == 0);
+
+    for(i = 0; i < n_icons; i++) {
+        XfdesktopIcon *icon = icons[i];
+
+        if(!xfdesktop_icon_view_adopt_item(icon_view, icon))
+            continue;
+
+        if(!gtk_widget_get_realized(GTK_WIDGET(icon_view))) {
+            /* if we aren't realized, we don't know what our grid looks
+             * like, so just hang onto the icon for later */
+            if(xfdesktop_icon_get_position(icon, &row, &col)) {
+                icon_view->priv->pending_icons = g_list_prepend(icon_view->priv->pending_icons,
+                                                                icon);
+            } else
+                overflow = g_list_prepend(overflow, icon);
+        } else if(xfdesktop_icon_get_position(icon, &row, &col)
+                  && xfdesktop_grid_is_free_position(icon_view, row, col))
+        {
+            xfdesktop_icon_view_add_item_internal(icon_view, icon);
+        } else
+            unplaced = g_list_prepend(unplaced, icon);
+    }
+
+    /* the icons that lost their spot, or never had one, go wherever
+     * there's room now that the others claimed theirs */
+    unplaced = g_list_reverse(unplaced);
+    for(l = unplaced; l; l = l->next) {
+        XfdesktopIcon *icon = l->data;
+
         if(xfdesktop_grid_get_next_free_position(icon_view, &row, &col)) {
             XF_DEBUG("old position didn't exist or isn't free, got (%d,%d) instead",
                      row, col);
             xfdesktop_icon_set_position(icon, row, col);
+            xfdesktop_icon_view_add_item_internal(icon_view, icon);
         } else {
             XF_DEBUG("can't fit icon on screen");
-            return FALSE;
+            overflow = g_list_prepend(overflow, icon);
         }
     }
-    
-    return TRUE;
+    g_list_free(unplaced);
+
+    if(overflow) {
+        icon_view->priv->pending_icons = g_list_concat(icon_view->priv->pending_icons,
+                                                       g_list_reverse(overflow));
+    }
 }
 
-void
-xfdesktop_icon_view_add_item(XfdesktopIconView *icon_view,
-                             XfdesktopIcon *icon)
+/* Takes @icon off the desktop, returns TRUE if it was selected */
+static gboolean
+xfdesktop_icon_view_detach_item(XfdesktopIconView *icon_view,
+                                XfdesktopIcon *icon)
 {
+    gboolean was_selected = xfdesktop_icon_get_is_selected(icon);
     gint16 row, col;
-    
-    g_return_if_fail(XFDESKTOP_IS_ICON_VIEW(icon_view)
-                     && XFDESKTOP_IS_ICON(icon));
-    
-    /* ensure the icon isn't already in an icon view */
-    g_return_if_fail(!g_object_get_data(G_OBJECT(icon),
-                                        "--xfdesktop-icon-view"));
-    
-    g_object_set_data(G_OBJECT(icon), "--xfdesktop-icon-view", icon_view);
-    g_object_ref(G_OBJECT(icon));
-    
-    if(!gtk_widget_get_realized(GTK_WIDGET(icon_view))) {
-        /* if we aren't realized, we don't know what our grid looks like, so
-         * just hang onto the icon for later */
-        if(xfdesktop_icon_get_position(icon, &row, &col)) {
-            icon_view->priv->pending_icons = g_list_prepend(icon_view->priv->pending_icons,
-                                                            icon);
-        } else {
-            icon_view->priv->pending_icons = g_list_append(icon_view->priv->pending_icons,
-                                                           icon);
-        }
-    } else {
-        if(xfdesktop_icon_view_icon_find_position(icon_view, icon))
-            xfdesktop_icon_view_add_item_internal(icon_view, icon);
-        else {
-            icon_view->priv->pending_icons = g_list_append(icon_view->priv->pending_icons,
-                                                           icon);
-        }
+
+    g_signal_handlers_disconnect_by_func(G_OBJECT(icon),
+                                         G_CALLBACK(xfdesktop_icon_view_icon_changed),
+                                         icon_view);
+
+    if(xfdesktop_icon_get_position(icon, &row, &col)) {
+        xfdesktop_icon_view_invalidate_icon(icon_view, icon, FALSE);
+        xfdesktop_grid_set_position_free(icon_view, row, col);
     }
+    xfdesktop_icon_view_unindex_icon(icon_view, icon);
+    if(was_selected) {
+        icon_view->priv->selected_icons = g_list_remove(icon_view->priv->selected_icons,
+                                                        icon);
+        xfdesktop_icon_set_is_selected(icon, FALSE);
+    }
+    if(icon_view->priv->cursor == icon) {
+        icon_view->priv->cursor = NULL;
+        if(icon_view->priv->selected_icons)
+            icon_view->priv->cursor = icon_view->priv->selected_icons->data;
+    }
+    if(icon_view->priv->first_clicked_item == icon)
+        icon_view->priv->first_clicked_item = NULL;
+    if(icon_view->priv->item_under_pointer == icon)
+        icon_view->priv->item_under_pointer = NULL;
+    xfdesktop_icon_invalidate_cached_surfaces(icon);
+    g_object_set_qdata(G_OBJECT(icon), xfdesktop_label_cache_quark, NULL);
+
+    return was_selected;
 }
 
 void
 xfdesktop_icon_view_remove_item(XfdesktopIconView *icon_view,
                                 XfdesktopIcon *icon)
 {
-    gint16 row, col;
-    GList *l;
-    
-    g_return_if_fail(XFDESKTOP_IS_ICON_VIEW(icon_view)
-                     && XFDESKTOP_IS_ICON(icon));
-    
-    l = g_list_find(icon_view->priv->icons, icon);
-    if(l) {
-        g_signal_handlers_disconnect_by_func(G_OBJECT(icon),
-                                             G_CALLBACK(xfdesktop_icon_view_icon_changed),
-                                             icon_view);
-        
-        if(xfdesktop_icon_get_position(icon, &row, &col)) {
-            xfdesktop_icon_view_invalidate_icon(icon_view, icon, FALSE);
-            xfdesktop_grid_set_position_free(icon_view, row, col);
-        }
+    xfdesktop_icon_view_remove_items(icon_view, &icon, 1);
+}
+
+/**
+ * xfdesktop_icon_view_remove_items:
+ * @icon_view: An #XfdesktopIconView.
+ * @icons: The icons to remove.
+ * @n_icons: The number of icons in @icons.
+ *
+ * Removes all of @icons with one walk over the icon lists, then fills the
+ * freed cells with icons that didn't fit before.  If any of @icons were
+ * selected, icon-selection-changed is emitted once at the end.
+ **/
+void
+xfdesktop_icon_view_remove_items(XfdesktopIconView *icon_view,
+                                 XfdesktopIcon **icons,
+                                 guint n_icons)
+{
+    GHashTable *to_remove;
+    GHashTableIter iter;
+    gpointer key;
+    GList *l, *next;
+    gboolean selection_changed = FALSE;
+    guint i;
+
+    g_return_if_fail(XFDESKTOP_IS_ICON_VIEW(icon_view));
+    g_return_if_fail(icons != NULL || n_icons == 0);
+
+    if(n_icons == 0)
+        return;
+
+    to_remove = g_hash_table_new(g_direct_hash, g_direct_equal);
+    for(i = 0; i < n_icons; i++)
+        g_hash_table_insert(to_remove, icons[i], icons[i]);
+
+    for(l = icon_view->priv->icons; l; l = next) {
+        XfdesktopIcon *icon = l->data;
+
+        next = l->next;
+        if(!g_hash_table_remove(to_remove, icon))
+            continue;
+
+        if(xfdesktop_icon_view_detach_item(icon_view, icon))
+            selection_changed = TRUE;
         icon_view->priv->icons = g_list_delete_link(icon_view->priv->icons, l);
-        icon_view->priv->selected_icons = g_list_remove(icon_view->priv->selected_icons,
-                                                        icon);
-        if(icon_view->priv->cursor == icon) {
-            icon_view->priv->cursor = NULL;
-            if(icon_view->priv->selected_icons)
-                icon_view->priv->cursor = icon_view->priv->selected_icons->data;
-        }
-        if(icon_view->priv->first_clicked_item == icon)
-            icon_view->priv->first_clicked_item = NULL;
-        if(icon_view->priv->item_under_pointer == icon)
-            icon_view->priv->item_under_pointer = NULL;
-    } else if((l = g_list_find(icon_view->priv->pending_icons, icon))) {
+
+        g_object_set_data(G_OBJECT(icon), "--xfdesktop-icon-view", NULL);
+        g_object_unref(G_OBJECT(icon));
+    }
+
+    for(l = icon_view->priv->pending_icons; l && g_hash_table_size(to_remove) > 0; l = next) {
+        XfdesktopIcon *icon = l->data;
+
+        next = l->next;
+        if(!g_hash_table_remove(to_remove, icon))
+            continue;
+
         icon_view->priv->pending_icons = g_list_delete_link(icon_view->priv->pending_icons,
                                                             l);
-    } else {
+
+        g_object_set_data(G_OBJECT(icon), "--xfdesktop-icon-view", NULL);
+        g_object_unref(G_OBJECT(icon));
+    }
+
+    g_hash_table_iter_init(&iter, to_remove);
+    while(g_hash_table_iter_next(&iter, &key, NULL)) {
         g_warning("Attempt to remove icon %p from XfdesktopIconView %p, but it's not in there.",
-                  icon, icon_view);
-        return;
+                  key, icon_view);
     }
-    
-    g_object_set_data(G_OBJECT(icon), "--xfdesktop-icon-view", NULL);
-    g_object_unref(G_OBJECT(icon));
+    g_hash_table_destroy(to_remove);
 
     if(icon_view->priv->pending_icons != NULL) {
         /* Move in any pending icons to the space available */
         xfdesktop_move_all_pending_icons_to_desktop(icon_view);
     }
+
+    if(selection_changed) {
+        g_signal_emit(G_OBJECT(icon_view),
+                      __signals[SIG_ICON_SELECTION_CHANGED],
+                      0, NULL);
+    }
 }
 
 void
@@ -3972,6 +4872,10 @@ xfdesktop_icon_view_remove_all(XfdesktopIconView *icon_view)
         g_signal_handlers_disconnect_by_func(G_OBJECT(l->data),
                                              G_CALLBACK(xfdesktop_icon_view_icon_changed),
                                              icon_view);
+        xfdesktop_icon_invalidate_cached_surfaces(icon);
+        g_object_set_qdata(G_OBJECT(icon), xfdesktop_label_cache_quark, NULL);
+        xfdesktop_icon_view_unindex_icon(icon_view, icon);
+        xfdesktop_icon_set_is_selected(icon, FALSE);
         g_object_set_data(G_OBJECT(l->data), "--xfdesktop-icon-view", NULL);
         g_object_unref(G_OBJECT(l->data));
     }
@@ -4182,6 +5086,7 @@ xfdesktop_icon_view_select_item(XfdesktopIconView *icon_view,
     
     icon_view->priv->selected_icons = g_list_prepend(icon_view->priv->selected_icons,
                                                      icon);
+    xfdesktop_icon_set_is_selected(icon, TRUE);
     xfdesktop_icon_view_invalidate_icon(icon_view, icon, TRUE);
     
     g_signal_emit(G_OBJECT(icon_view),
@@ -4215,6 +5120,7 @@ xfdesktop_icon_view_select_all(XfdesktopIconView *icon_view)
 
     for(l = icon_view->priv->icons; l; l = l->next) {
         icon_view->priv->selected_icons = g_list_prepend(icon_view->priv->selected_icons, l->data);
+        xfdesktop_icon_set_is_selected(l->data, TRUE);
         xfdesktop_icon_view_invalidate_icon(icon_view, l->data, TRUE);
         xfdesktop_icon_selected(l->data);
     }
@@ -4233,10 +5139,14 @@ xfdesktop_icon_view_unselect_item(XfdesktopIconView *icon_view,
     g_return_if_fail(XFDESKTOP_IS_ICON_VIEW(icon_view)
                      && XFDESKTOP_IS_ICON(icon));
     
+    if(!xfdesktop_icon_get_is_selected(icon))
+        return;
+
     l = g_list_find(icon_view->priv->selected_icons, icon);
     if(l) {
         icon_view->priv->selected_icons = g_list_delete_link(icon_view->priv->selected_icons,
                                                              l);
+        xfdesktop_icon_set_is_selected(icon, FALSE);
         xfdesktop_icon_view_invalidate_icon(icon_view, icon, TRUE);
         g_signal_emit(G_OBJECT(icon_view),
                       __signals[SIG_ICON_SELECTION_CHANGED],
@@ -4252,6 +5162,8 @@ xfdesktop_icon_view_unselect_all(XfdesktopIconView *icon_view)
     if(icon_view->priv->selected_icons) {
         GList *repaint_icons = icon_view->priv->selected_icons;
         icon_view->priv->selected_icons = NULL;
+        g_list_foreach(repaint_icons, xfdesktop_list_foreach_unset_selected,
+                       NULL);
         g_list_foreach(repaint_icons, xfdesktop_list_foreach_invalidate,
                        icon_view);
         g_list_free(repaint_icons);
@@ -4271,6 +5183,7 @@ xfdesktop_icon_view_set_icon_size(XfdesktopIconView *icon_view,
         return;
     
     icon_view->priv->icon_size = icon_size;
+    xfdesktop_icon_view_invalidate_cached_surfaces(icon_view);
     
     if(gtk_widget_get_realized(GTK_WIDGET(icon_view))) {
         xfdesktop_grid_do_resize(icon_view);
@@ -4295,6 +5208,7 @@ xfdesktop_icon_view_set_font_size(XfdesktopIconView *icon_view,
         return;
     
     icon_view->priv->font_size = font_size_points;
+    xfdesktop_icon_view_invalidate_cached_surfaces(icon_view);
     
     if(gtk_widget_get_realized(GTK_WIDGET(icon_view))) {
         xfdesktop_icon_view_modify_font_size(icon_view, font_size_points);
@@ -4320,12 +5234,56 @@ xfdesktop_icon_view_set_center_text (XfdesktopIconView *icon_view,
         return;
     
     icon_view->priv->center_text = center_text;
+    xfdesktop_icon_view_invalidate_cached_surfaces(icon_view);
     
     if(gtk_widget_get_realized(GTK_WIDGET(icon_view))) {
         gtk_widget_queue_draw(GTK_WIDGET(icon_view));
     }
 }
 
+/**
+ * xfdesktop_icon_view_set_background:
+ * @icon_view: An #XfdesktopIconView.
+ * @pixmap: The pixmap the desktop window's background comes from, or %NULL.
+ *
+ * With a background, the icon view keeps the wallpaper and the icons
+ * drawn on top of it in an off-screen surface, so repainting a part of
+ * the desktop that didn't change is a single copy.  Call
+ * xfdesktop_icon_view_background_changed() whenever @pixmap is drawn to.
+ * Passing %NULL while @pixmap is being redrawn many times in a row (e.g.
+ * during a fade) avoids keeping the off-screen copy up to date for
+ * nothing.  The "use-backing-store" property turns this off entirely.
+ **/
+void
+xfdesktop_icon_view_set_background(XfdesktopIconView *icon_view,
+                                   GdkPixmap *pixmap)
+{
+    g_return_if_fail(XFDESKTOP_IS_ICON_VIEW(icon_view));
+    g_return_if_fail(pixmap == NULL || GDK_IS_PIXMAP(pixmap));
+
+    if(pixmap == icon_view->priv->background)
+        return;
+
+    if(pixmap)
+        g_object_ref(G_OBJECT(pixmap));
+    if(icon_view->priv->background)
+        g_object_unref(G_OBJECT(icon_view->priv->background));
+    icon_view->priv->background = pixmap;
+
+    xfdesktop_icon_view_drop_backing(icon_view);
+
+    gtk_widget_queue_draw(GTK_WIDGET(icon_view));
+}
+
+void
+xfdesktop_icon_view_background_changed(XfdesktopIconView *icon_view,
+                                       const GdkRectangle *area)
+{
+    g_return_if_fail(XFDESKTOP_IS_ICON_VIEW(icon_view) && area);
+
+    xfdesktop_icon_view_damage_backing(icon_view, area);
+}
+
 GtkWidget *
 xfdesktop_icon_view_get_window_widget(XfdesktopIconView *icon_view)
 {
@@ -4340,4 +5298,18 @@ _xfdesktop_icon_view_n_items(XfdesktopIconView *icon_view)
 {
     return g_list_length(icon_view->priv->pending_icons) + g_list_length(icon_view->priv->icons);
 }
+
+void
+_xfdesktop_icon_view_get_damage_stats(XfdesktopIconView *icon_view,
+                                      guint64 *rects_submitted,
+                                      guint64 *rects_flushed,
+                                      guint64 *area_flushed)
+{
+    if(rects_submitted)
+        *rects_submitted = icon_view->priv->damage_rects_submitted;
+    if(rects_flushed)
+        *rects_flushed = icon_view->priv->damage_rects_flushed;
+    if(area_flushed)
+        *area_flushed = icon_view->priv->damage_area_flushed;
+}
 #endif
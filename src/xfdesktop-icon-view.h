@@ -76,9 +76,15 @@ GtkWidget *xfdesktop_icon_view_new(XfdesktopIconViewManager *manager);
 
 void xfdesktop_icon_view_add_item(XfdesktopIconView *icon_view,
                                   XfdesktopIcon *icon);
+void xfdesktop_icon_view_add_items(XfdesktopIconView *icon_view,
+                                   XfdesktopIcon **icons,
+                                   guint n_icons);
 
 void xfdesktop_icon_view_remove_item(XfdesktopIconView *icon_view,
                                      XfdesktopIcon *icon);
+void xfdesktop_icon_view_remove_items(XfdesktopIconView *icon_view,
+                                      XfdesktopIcon **icons,
+                                      guint n_icons);
 void xfdesktop_icon_view_remove_all(XfdesktopIconView *icon_view);
 
 void xfdesktop_icon_view_set_selection_mode(XfdesktopIconView *icon_view,
@@ -120,6 +126,11 @@ gdouble xfdesktop_icon_view_get_font_size(XfdesktopIconView *icon_view);
 void xfdesktop_icon_view_set_center_text (XfdesktopIconView *icon_view,
                                           gboolean center_text);
 
+void xfdesktop_icon_view_set_background(XfdesktopIconView *icon_view,
+                                        GdkPixmap *pixmap);
+void xfdesktop_icon_view_background_changed(XfdesktopIconView *icon_view,
+                                            const GdkRectangle *area);
+
 GtkWidget *xfdesktop_icon_view_get_window_widget(XfdesktopIconView *icon_view);
 
 gboolean
@@ -129,11 +140,18 @@ xfdesktop_get_workarea_single(XfdesktopIconView *icon_view,
                               gint *yorigin,
                               gint *width,
                               gint *height);
+void xfdesktop_icon_view_get_workarea_size(XfdesktopIconView *icon_view,
+                                           gint *width,
+                                           gint *height);
 
 void xfdesktop_icon_view_sort_icons(XfdesktopIconView *icon_view);
 
 #if defined(DEBUG) && DEBUG > 0
 guint _xfdesktop_icon_view_n_items(XfdesktopIconView *icon_view);
+void _xfdesktop_icon_view_get_damage_stats(XfdesktopIconView *icon_view,
+                                           guint64 *rects_submitted,
+                                           guint64 *rects_flushed,
+                                           guint64 *area_flushed);
 #endif
 
 G_END_DECLS
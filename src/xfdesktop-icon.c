@@ -29,6 +29,8 @@
 #include <glib-object.h>
 #include <gobject/gmarshal.h>
 
+#include <exo/exo.h>
+
 #include "xfdesktop-icon.h"
 #include "xfdesktop-marshal.h"
 
@@ -41,9 +43,22 @@ struct _XfdesktopIconPrivate
     GdkRectangle text_extents;
     GdkRectangle total_extents;
 
+    /* whether the icon view has it selected */
+    guint selected:1;
+
     GdkPixbuf *pix, *tooltip_pix;
     gint cur_pix_width, cur_pix_height;
     gint cur_tooltip_pix_width, cur_tooltip_pix_height;
+
+    /* colorized and/or spotlighted versions of pix, indexed by draw
+     * state, and the colour each one was colorized with */
+    GdkPixbuf *state_pix[XFDESKTOP_ICON_DRAW_N_STATES];
+    GdkColor state_pix_colors[XFDESKTOP_ICON_DRAW_N_STATES];
+
+    /* what the icon view last drew for each state; the areas are relative
+     * to the icon's cell */
+    cairo_surface_t *surfaces[XFDESKTOP_ICON_DRAW_N_STATES];
+    GdkRectangle surface_areas[XFDESKTOP_ICON_DRAW_N_STATES];
 };
 
 enum {
@@ -132,6 +147,9 @@ xfdesktop_icon_finalize(GObject *obj)
     XfdesktopIcon *icon = XFDESKTOP_ICON(obj);
 
     xfdesktop_icon_invalidate_pixbuf(icon);
+    xfdesktop_icon_invalidate_cached_surfaces(icon);
+
+    G_OBJECT_CLASS(xfdesktop_icon_parent_class)->finalize(obj);
 }
 
 void
@@ -192,6 +210,70 @@ xfdesktop_icon_get_extents(XfdesktopIcon *icon,
     return TRUE;
 }
 
+/* Takes ownership of @surface.  @area is where @surface goes, relative to
+ * the icon's cell. */
+void
+xfdesktop_icon_set_cached_surface(XfdesktopIcon *icon,
+                                  XfdesktopIconDrawState state,
+                                  cairo_surface_t *surface,
+                                  const GdkRectangle *area)
+{
+    g_return_if_fail(XFDESKTOP_IS_ICON(icon)
+                     && state < XFDESKTOP_ICON_DRAW_N_STATES && area);
+
+    if(icon->priv->surfaces[state])
+        cairo_surface_destroy(icon->priv->surfaces[state]);
+
+    icon->priv->surfaces[state] = surface;
+    icon->priv->surface_areas[state] = *area;
+}
+
+cairo_surface_t *
+xfdesktop_icon_peek_cached_surface(XfdesktopIcon *icon,
+                                   XfdesktopIconDrawState state,
+                                   GdkRectangle *area)
+{
+    g_return_val_if_fail(XFDESKTOP_IS_ICON(icon)
+                         && state < XFDESKTOP_ICON_DRAW_N_STATES, NULL);
+
+    if(area && icon->priv->surfaces[state])
+        *area = icon->priv->surface_areas[state];
+
+    return icon->priv->surfaces[state];
+}
+
+void
+xfdesktop_icon_invalidate_cached_surfaces(XfdesktopIcon *icon)
+{
+    gint i;
+
+    g_return_if_fail(XFDESKTOP_IS_ICON(icon));
+
+    for(i = 0; i < XFDESKTOP_ICON_DRAW_N_STATES; i++) {
+        if(icon->priv->surfaces[i]) {
+            cairo_surface_destroy(icon->priv->surfaces[i]);
+            icon->priv->surfaces[i] = NULL;
+        }
+    }
+}
+
+void
+xfdesktop_icon_set_is_selected(XfdesktopIcon *icon,
+                               gboolean selected)
+{
+    g_return_if_fail(XFDESKTOP_IS_ICON(icon));
+
+    icon->priv->selected = selected ? 1 : 0;
+}
+
+gboolean
+xfdesktop_icon_get_is_selected(XfdesktopIcon *icon)
+{
+    g_return_val_if_fail(XFDESKTOP_IS_ICON(icon), FALSE);
+
+    return icon->priv->selected;
+}
+
 /*< required >*/
 GdkPixbuf *
 xfdesktop_icon_peek_pixbuf(XfdesktopIcon *icon,
@@ -217,6 +299,68 @@ xfdesktop_icon_peek_pixbuf(XfdesktopIcon *icon,
     return icon->priv->pix;
 }
 
+/**
+ * xfdesktop_icon_peek_state_pixbuf:
+ * @icon: An #XfdesktopIcon.
+ * @width: The maximum width of the pixbuf.
+ * @height: The maximum height of the pixbuf.
+ * @state: What the icon is drawn as.
+ * @color: The colour selected icons are tinted with; unused for
+ *         %XFDESKTOP_ICON_DRAW_NORMAL and %XFDESKTOP_ICON_DRAW_NORMAL_HOVERED.
+ *
+ * Like xfdesktop_icon_peek_pixbuf(), but colorized for the selected
+ * states and spotlighted for the hovered ones.  The result is kept until
+ * the pixbuf is invalidated or @color changes.
+ *
+ * Return value: A #GdkPixbuf owned by @icon, or %NULL.
+ **/
+GdkPixbuf *
+xfdesktop_icon_peek_state_pixbuf(XfdesktopIcon *icon,
+                                 gint width, gint height,
+                                 XfdesktopIconDrawState state,
+                                 const GdkColor *color)
+{
+    GdkPixbuf *pix, *base;
+    gboolean colorized;
+
+    g_return_val_if_fail(XFDESKTOP_IS_ICON(icon)
+                         && state < XFDESKTOP_ICON_DRAW_N_STATES, NULL);
+
+    colorized = (state != XFDESKTOP_ICON_DRAW_NORMAL
+                 && state != XFDESKTOP_ICON_DRAW_NORMAL_HOVERED);
+    g_return_val_if_fail(color || !colorized, NULL);
+
+    /* drops the variants too if the size changed */
+    pix = xfdesktop_icon_peek_pixbuf(icon, width, height);
+    if(!pix || state == XFDESKTOP_ICON_DRAW_NORMAL)
+        return pix;
+
+    if(icon->priv->state_pix[state]) {
+        if(!colorized
+           || gdk_color_equal(color, &icon->priv->state_pix_colors[state]))
+        {
+            return icon->priv->state_pix[state];
+        }
+
+        g_object_unref(G_OBJECT(icon->priv->state_pix[state]));
+        icon->priv->state_pix[state] = NULL;
+    }
+
+    if(state >= XFDESKTOP_ICON_DRAW_NORMAL_HOVERED) {
+        /* spotlight whatever the icon looks like when not hovered */
+        base = xfdesktop_icon_peek_state_pixbuf(icon, width, height,
+                                                state - XFDESKTOP_ICON_DRAW_NORMAL_HOVERED,
+                                                color);
+        icon->priv->state_pix[state] = exo_gdk_pixbuf_spotlight(base);
+    } else
+        icon->priv->state_pix[state] = exo_gdk_pixbuf_colorize(pix, color);
+
+    if(colorized)
+        icon->priv->state_pix_colors[state] = *color;
+
+    return icon->priv->state_pix[state];
+}
+
 /*< required >*/
 const gchar *
 xfdesktop_icon_peek_label(XfdesktopIcon *icon)
@@ -397,10 +541,22 @@ xfdesktop_icon_peek_icon_view(XfdesktopIcon *icon)
 void
 xfdesktop_icon_invalidate_regular_pixbuf(XfdesktopIcon *icon)
 {
+    gint i;
+
     if(icon->priv->pix) {
         g_object_unref(G_OBJECT(icon->priv->pix));
         icon->priv->pix = NULL;
     }
+
+    for(i = 0; i < XFDESKTOP_ICON_DRAW_N_STATES; i++) {
+        if(icon->priv->state_pix[i]) {
+            g_object_unref(G_OBJECT(icon->priv->state_pix[i]));
+            icon->priv->state_pix[i] = NULL;
+        }
+    }
+
+    /* they were drawn from the old pixbuf */
+    xfdesktop_icon_invalidate_cached_surfaces(icon);
 }
 
 void
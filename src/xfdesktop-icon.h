@@ -35,6 +35,19 @@ typedef struct _XfdesktopIcon        XfdesktopIcon;
 typedef struct _XfdesktopIconClass   XfdesktopIconClass;
 typedef struct _XfdesktopIconPrivate XfdesktopIconPrivate;
 
+/* the ways XfdesktopIconView can draw an icon; each of them gets its own
+ * cached rendering */
+typedef enum
+{
+    XFDESKTOP_ICON_DRAW_NORMAL = 0,
+    XFDESKTOP_ICON_DRAW_SELECTED,  /* selected, icon view has the focus */
+    XFDESKTOP_ICON_DRAW_ACTIVE,    /* selected, icon view doesn't have it */
+    XFDESKTOP_ICON_DRAW_NORMAL_HOVERED,
+    XFDESKTOP_ICON_DRAW_SELECTED_HOVERED,
+    XFDESKTOP_ICON_DRAW_ACTIVE_HOVERED,
+    XFDESKTOP_ICON_DRAW_N_STATES,
+} XfdesktopIconDrawState;
+
 struct _XfdesktopIcon
 {
     GObject parent;
@@ -144,6 +157,21 @@ gboolean xfdesktop_icon_get_extents(XfdesktopIcon *icon,
                                     GdkRectangle *pixbuf_extents,
                                     GdkRectangle *text_extents,
                                     GdkRectangle *total_extents);
+void xfdesktop_icon_set_cached_surface(XfdesktopIcon *icon,
+                                       XfdesktopIconDrawState state,
+                                       cairo_surface_t *surface,
+                                       const GdkRectangle *area);
+cairo_surface_t *xfdesktop_icon_peek_cached_surface(XfdesktopIcon *icon,
+                                                    XfdesktopIconDrawState state,
+                                                    GdkRectangle *area);
+void xfdesktop_icon_invalidate_cached_surfaces(XfdesktopIcon *icon);
+GdkPixbuf *xfdesktop_icon_peek_state_pixbuf(XfdesktopIcon *icon,
+                                            gint width, gint height,
+                                            XfdesktopIconDrawState state,
+                                            const GdkColor *color);
+void xfdesktop_icon_set_is_selected(XfdesktopIcon *icon,
+                                   gboolean selected);
+gboolean xfdesktop_icon_get_is_selected(XfdesktopIcon *icon);
 
 G_END_DECLS
 
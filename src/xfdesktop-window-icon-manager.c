@@ -210,13 +210,12 @@ xfdesktop_window_icon_manager_add_icon(XfdesktopWindowIconManager *wmanager,
 }
 
 static void
-xfdesktop_add_window_icons_foreach(gpointer key,
-                                   gpointer value,
-                                   gpointer user_data)
+xfdesktop_collect_window_icons_foreach(gpointer key,
+                                       gpointer value,
+                                       gpointer user_data)
 {
-    XfdesktopIcon *icon = value;
-    XfdesktopWindowIconManager *wmanager = user_data;
-    xfdesktop_icon_view_add_item(wmanager->priv->icon_view, icon);
+    GPtrArray *icons = user_data;
+    g_ptr_array_add(icons, value);
 }
 
 static void
@@ -260,9 +259,17 @@ workspace_changed_cb(WnckScreen *wnck_screen,
                                                        window, n);
             }
         }
-    } else
+    } else {
+        GPtrArray *icons = g_ptr_array_new();
+
+        /* hand them to the icon view all at once */
         g_hash_table_foreach(wmanager->priv->icon_workspaces[n]->icons,
-                             xfdesktop_add_window_icons_foreach, wmanager);
+                             xfdesktop_collect_window_icons_foreach, icons);
+        xfdesktop_icon_view_add_items(wmanager->priv->icon_view,
+                                      (XfdesktopIcon **)icons->pdata,
+                                      icons->len);
+        g_ptr_array_free(icons, TRUE);
+    }
     
     if(wmanager->priv->icon_workspaces[n]->selected_icon) {
         xfdesktop_icon_view_select_item(wmanager->priv->icon_view,